@@ -2,9 +2,26 @@
 #include "MMU.h"
 
 APU::APU(MMU& mmu) : mmu(mmu) {
+    connectIO();
     reset();
 }
 
+void APU::connectIO() {
+    for (uint32_t address = 0x04000060; address < 0x040000A0; address += 2) {
+        mmu.setIOReadHandler(address, [this, address]() { return readRegister(address); });
+        mmu.setIOWriteHandler(address, [this, address](uint16_t value) { writeRegister(address, value); });
+    }
+
+    mmu.setIOWriteHandler(0x040000A0, [this](uint16_t value) { fifoALow = value; });
+    mmu.setIOWriteHandler(0x040000A2, [this](uint16_t value) {
+        writeFifoA(fifoALow | (static_cast<uint32_t>(value) << 16));
+    });
+    mmu.setIOWriteHandler(0x040000A4, [this](uint16_t value) { fifoBLow = value; });
+    mmu.setIOWriteHandler(0x040000A6, [this](uint16_t value) {
+        writeFifoB(fifoBLow | (static_cast<uint32_t>(value) << 16));
+    });
+}
+
 void APU::reset() {
     registers.fill(0);
     fifoA.fill(0);
@@ -13,6 +30,8 @@ void APU::reset() {
     fifoBPos = 0;
     fifoASize = 0;
     fifoBSize = 0;
+    fifoALow = 0;
+    fifoBLow = 0;
     cycleCounter = 0;
     sampleBuffer.clear();
     sampleBuffer.reserve(2048);
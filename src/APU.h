@@ -8,6 +8,8 @@ class MMU;
 
 class APU {
 public:
+    static constexpr int SAMPLE_RATE = 32768;
+
     APU(MMU& mmu);
     
     void reset();
@@ -23,6 +25,7 @@ public:
     void writeFifoB(uint32_t value);
     
 private:
+    void connectIO();
     void generateSample();
     int16_t generateSquare1();
     int16_t generateSquare2();
@@ -31,7 +34,7 @@ private:
     
     MMU& mmu;
     
-    std::array<uint16_t, 0x18> registers{};
+    std::array<uint16_t, 0x58> registers{};
     
     std::array<int8_t, 32> fifoA{};
     std::array<int8_t, 32> fifoB{};
@@ -39,9 +42,11 @@ private:
     int fifoBPos = 0;
     int fifoASize = 0;
     int fifoBSize = 0;
+    uint16_t fifoALow = 0;
+    uint16_t fifoBLow = 0;
     
     int cycleCounter = 0;
-    static constexpr int CYCLES_PER_SAMPLE = 512;
+    static constexpr int CYCLES_PER_SAMPLE = 16777216 / SAMPLE_RATE;
     
     std::vector<int16_t> sampleBuffer;
     
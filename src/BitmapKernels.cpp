@@ -0,0 +1,94 @@
+#include "BitmapKernels.h"
+#include "Renderer.h"
+
+#if defined(PPU_AVX2_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace BitmapKernels {
+
+namespace {
+
+#ifdef PPU_USE_SSE2
+void directColorsSSE2(const uint8_t* src, uint16_t* dst, int count) {
+    const __m128i mask = _mm_set1_epi16(0x7FFF);
+    for (int i = 0; i < count; i += 8) {
+        __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(colors, mask));
+    }
+}
+
+void paletteIndicesSSE2(const uint8_t* src, const uint16_t* palette, uint16_t* dst, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i transparent = _mm_set1_epi16(static_cast<short>(PIXEL_TRANSPARENT));
+    for (int i = 0; i < count; i += 8) {
+        const uint8_t* index = src + i;
+        __m128i colors = _mm_setr_epi16(palette[index[0]], palette[index[1]], palette[index[2]], palette[index[3]],
+                                        palette[index[4]], palette[index[5]], palette[index[6]], palette[index[7]]);
+        __m128i indices = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(index)), zero);
+        __m128i backdrop = _mm_cmpeq_epi16(indices, zero);
+        colors = _mm_or_si128(_mm_andnot_si128(backdrop, colors), _mm_and_si128(backdrop, transparent));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), colors);
+    }
+}
+#endif
+
+void directColorsScalar(const uint8_t* src, uint16_t* dst, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = (src[i * 2] | (src[i * 2 + 1] << 8)) & 0x7FFF;
+    }
+}
+
+void paletteIndicesScalar(const uint8_t* src, const uint16_t* palette, uint16_t* dst, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = src[i] ? palette[src[i]] : PIXEL_TRANSPARENT;
+    }
+}
+
+#ifdef PPU_AVX2_KERNELS
+bool cpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osSaves = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSaves && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+Kernels detect() {
+#ifdef PPU_AVX2_KERNELS
+    if (cpuHasAVX2()) {
+        return {"AVX2", directColorsAVX2, paletteIndicesAVX2};
+    }
+#endif
+#ifdef PPU_USE_SSE2
+    return {"SSE2", directColorsSSE2, paletteIndicesSSE2};
+#else
+    return {"scalar", directColorsScalar, paletteIndicesScalar};
+#endif
+}
+}
+
+const Kernels& select() {
+    static const Kernels kernels = detect();
+    return kernels;
+}
+
+std::vector<Kernels> available() {
+    std::vector<Kernels> kernels = {{"scalar", directColorsScalar, paletteIndicesScalar}};
+#ifdef PPU_USE_SSE2
+    kernels.push_back({"SSE2", directColorsSSE2, paletteIndicesSSE2});
+#endif
+#ifdef PPU_AVX2_KERNELS
+    if (cpuHasAVX2()) {
+        kernels.push_back({"AVX2", directColorsAVX2, paletteIndicesAVX2});
+    }
+#endif
+    return kernels;
+}
+
+}
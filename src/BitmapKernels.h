@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace BitmapKernels {
+
+// Pixel counts must be a multiple of 16, and palettes must stay readable one
+// entry past index 255.
+using DirectColorFn = void (*)(const uint8_t* src, uint16_t* dst, int count);
+using PaletteIndexFn = void (*)(const uint8_t* src, const uint16_t* palette, uint16_t* dst, int count);
+
+struct Kernels {
+    const char* name;
+    DirectColorFn directColors;
+    PaletteIndexFn paletteIndices;
+};
+
+const Kernels& select();
+
+// Every kernel set this CPU can run, scalar reference first.
+std::vector<Kernels> available();
+
+#ifdef PPU_AVX2_KERNELS
+void directColorsAVX2(const uint8_t* src, uint16_t* dst, int count);
+void paletteIndicesAVX2(const uint8_t* src, const uint16_t* palette, uint16_t* dst, int count);
+#endif
+
+}
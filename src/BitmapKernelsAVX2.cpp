@@ -0,0 +1,33 @@
+#include "BitmapKernels.h"
+#include "Renderer.h"
+
+#ifdef PPU_AVX2_KERNELS
+#include <immintrin.h>
+
+namespace BitmapKernels {
+
+void directColorsAVX2(const uint8_t* src, uint16_t* dst, int count) {
+    const __m256i mask = _mm256_set1_epi16(0x7FFF);
+    for (int i = 0; i < count; i += 16) {
+        __m256i colors = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(colors, mask));
+    }
+}
+
+void paletteIndicesAVX2(const uint8_t* src, const uint16_t* palette, uint16_t* dst, int count) {
+    const int* table = reinterpret_cast<const int*>(palette);
+    const __m256i low = _mm256_set1_epi32(0xFFFF);
+    const __m256i transparent = _mm256_set1_epi16(static_cast<short>(PIXEL_TRANSPARENT));
+    for (int i = 0; i < count; i += 16) {
+        __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256i first = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 2);
+        __m256i second = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 2);
+        __m256i colors = _mm256_packus_epi32(_mm256_and_si256(first, low), _mm256_and_si256(second, low));
+        colors = _mm256_permute4x64_epi64(colors, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i backdrop = _mm256_cmpeq_epi16(_mm256_cvtepu8_epi16(indices), _mm256_setzero_si256());
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(colors, transparent, backdrop));
+    }
+}
+
+}
+#endif
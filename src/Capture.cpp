@@ -0,0 +1,251 @@
+#include "Capture.h"
+#include "APU.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(5);
+
+constexpr uint32_t FRAME_RATE_NUMERATOR = 16777216;
+constexpr uint32_t FRAME_RATE_DENOMINATOR = 280896;
+
+uint8_t clampByte(int value) {
+    return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+// "out.wav" part 2 becomes "out.002.wav".
+std::string numberedPath(const std::string& path, uint32_t part) {
+    char number[16];
+    snprintf(number, sizeof(number), ".%03u", part);
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + number;
+    }
+    return path.substr(0, dot) + number + path.substr(dot);
+}
+}
+
+Capture::Capture()
+    : frames(std::make_unique<SPSCQueue<VideoFrame, FRAME_SLOTS>>()),
+      audio(std::make_unique<SPSCQueue<AudioBlock, AUDIO_SLOTS>>()) {
+}
+
+Capture::~Capture() {
+    stop();
+}
+
+bool Capture::start(const std::string& videoPath, VideoFormat format, const std::string& audioPath) {
+    stop();
+
+    if (!videoPath.empty()) {
+        videoFile.open(videoPath, std::ios::binary | std::ios::trunc);
+        if (!videoFile) return false;
+    }
+    if (!audioPath.empty()) {
+        audioFile.open(audioPath, std::ios::binary | std::ios::trunc);
+        if (!audioFile) {
+            videoFile.close();
+            return false;
+        }
+    }
+
+    this->audioPath = audioPath;
+    videoFormat = format;
+    capturingVideo = videoFile.is_open();
+    capturingAudio = audioFile.is_open();
+    audioBytes = 0;
+    audioPart = 0;
+    framesWritten = 0;
+    droppedFrames = 0;
+    droppedSamples = 0;
+
+    if (videoFile.is_open() && videoFormat == VideoFormat::Y4M) {
+        videoFile << "YUV4MPEG2 W" << SCREEN_WIDTH << " H" << SCREEN_HEIGHT << " F" << FRAME_RATE_NUMERATOR / 64 << ":"
+                  << FRAME_RATE_DENOMINATOR / 64 << " Ip A1:1 C444\n";
+    }
+    if (audioFile.is_open()) {
+        writeWavHeader(0);
+    }
+
+    stopping = false;
+    writer = std::thread(&Capture::writerLoop, this);
+    return true;
+}
+
+void Capture::stop() {
+    if (!writer.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopping = true;
+    }
+    writerCondition.notify_all();
+    writer.join();
+
+    finishAudioFile();
+    videoFile.close();
+    capturingVideo = false;
+    capturingAudio = false;
+}
+
+void Capture::setAudioSplitBytes(uint64_t bytes) {
+    audioSplitBytes = std::clamp<uint64_t>(bytes & ~3ull, 4, MAX_WAV_DATA_BYTES);
+}
+
+void Capture::pushFrame(const uint32_t* pixels) {
+    if (!writer.joinable() || !capturingVideo) return;
+
+    VideoFrame* slot = frames->acquire();
+    if (!slot) {
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::memcpy(slot->data(), pixels, sizeof(VideoFrame));
+    frames->commit();
+}
+
+void Capture::pushAudio(const int16_t* samples, size_t count) {
+    if (!writer.joinable() || !capturingAudio) return;
+
+    while (count > 0) {
+        AudioBlock* slot = audio->acquire();
+        if (!slot) {
+            droppedSamples.fetch_add(count / 2, std::memory_order_relaxed);
+            return;
+        }
+        size_t chunk = std::min(count, slot->samples.size());
+        std::memcpy(slot->samples.data(), samples, chunk * sizeof(int16_t));
+        slot->count = static_cast<uint32_t>(chunk);
+        audio->commit();
+
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+void Capture::writerLoop() {
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (true) {
+        lock.unlock();
+        bool wrote = drain();
+        lock.lock();
+
+        if (stopping) {
+            lock.unlock();
+            while (drain()) {
+            }
+            return;
+        }
+        if (!wrote) {
+            writerCondition.wait_for(lock, POLL_INTERVAL, [this]() { return stopping; });
+        }
+    }
+}
+
+bool Capture::drain() {
+    bool wrote = false;
+
+    while (const AudioBlock* block = audio->peek()) {
+        writeAudio(block->samples.data(), block->count);
+        audio->release();
+        wrote = true;
+    }
+
+    if (const VideoFrame* frame = frames->peek()) {
+        writeFrame(*frame);
+        frames->release();
+        framesWritten.fetch_add(1, std::memory_order_relaxed);
+        wrote = true;
+    }
+
+    return wrote;
+}
+
+void Capture::writeFrame(const VideoFrame& frame) {
+    constexpr size_t PIXELS = SCREEN_WIDTH * SCREEN_HEIGHT;
+
+    if (videoFormat == VideoFormat::RawRGB) {
+        encoded.resize(PIXELS * 3);
+        for (size_t i = 0; i < PIXELS; i++) {
+            encoded[i * 3] = (frame[i] >> 16) & 0xFF;
+            encoded[i * 3 + 1] = (frame[i] >> 8) & 0xFF;
+            encoded[i * 3 + 2] = frame[i] & 0xFF;
+        }
+        videoFile.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        return;
+    }
+
+    encoded.resize(PIXELS * 3);
+    uint8_t* y = encoded.data();
+    uint8_t* u = y + PIXELS;
+    uint8_t* v = u + PIXELS;
+    for (size_t i = 0; i < PIXELS; i++) {
+        int r = (frame[i] >> 16) & 0xFF;
+        int g = (frame[i] >> 8) & 0xFF;
+        int b = frame[i] & 0xFF;
+        y[i] = clampByte(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[i] = clampByte(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[i] = clampByte(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    videoFile << "FRAME\n";
+    videoFile.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+}
+
+void Capture::writeAudio(const int16_t* samples, size_t count) {
+    const char* data = reinterpret_cast<const char*>(samples);
+    uint64_t bytes = count * sizeof(int16_t);
+    while (bytes > 0) {
+        if (!audioFile.is_open() || (audioBytes == audioSplitBytes && !nextAudioFile())) {
+            droppedSamples.fetch_add(bytes / 4, std::memory_order_relaxed);
+            return;
+        }
+        uint64_t chunk = std::min(bytes, audioSplitBytes - audioBytes);
+        audioFile.write(data, static_cast<std::streamsize>(chunk));
+        audioBytes += chunk;
+        data += chunk;
+        bytes -= chunk;
+    }
+}
+
+bool Capture::nextAudioFile() {
+    finishAudioFile();
+    audioFile.open(numberedPath(audioPath, ++audioPart), std::ios::binary | std::ios::trunc);
+    if (!audioFile) return false;
+
+    audioBytes = 0;
+    writeWavHeader(0);
+    return true;
+}
+
+void Capture::finishAudioFile() {
+    if (!audioFile.is_open()) return;
+
+    audioFile.seekp(0);
+    writeWavHeader(static_cast<uint32_t>(audioBytes));
+    audioFile.close();
+}
+
+void Capture::writeWavHeader(uint32_t dataBytes) {
+    constexpr uint16_t CHANNELS = 2;
+    constexpr uint16_t BITS = 16;
+
+    uint8_t header[44];
+    std::memcpy(header, "RIFF", 4);
+    Utils::write32(header + 4, 36 + dataBytes);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    Utils::write32(header + 16, 16);
+    Utils::write16(header + 20, 1);
+    Utils::write16(header + 22, CHANNELS);
+    Utils::write32(header + 24, APU::SAMPLE_RATE);
+    Utils::write32(header + 28, APU::SAMPLE_RATE * CHANNELS * BITS / 8);
+    Utils::write16(header + 32, CHANNELS * BITS / 8);
+    Utils::write16(header + 34, BITS);
+    std::memcpy(header + 36, "data", 4);
+    Utils::write32(header + 40, dataBytes);
+    audioFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Renderer.h"
+#include "SPSCQueue.h"
+
+class Capture {
+public:
+    enum class VideoFormat {
+        Y4M,
+        RawRGB
+    };
+
+    Capture();
+    ~Capture();
+
+    bool start(const std::string& videoPath, VideoFormat format, const std::string& audioPath);
+    void stop();
+    bool isActive() const { return writer.joinable(); }
+
+    void pushFrame(const uint32_t* pixels);
+    void pushAudio(const int16_t* samples, size_t count);
+
+    uint64_t getFramesWritten() const { return framesWritten.load(); }
+    uint64_t getDroppedFrames() const { return droppedFrames.load(); }
+    uint64_t getDroppedSamples() const { return droppedSamples.load(); }
+
+    // Starts a new WAV file after this many data bytes instead of at the RIFF
+    // limit, rounded down to whole stereo frames. Call before start().
+    void setAudioSplitBytes(uint64_t bytes);
+
+private:
+    using VideoFrame = std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT>;
+
+    struct AudioBlock {
+        std::array<int16_t, 4096> samples;
+        uint32_t count;
+    };
+
+    static constexpr size_t FRAME_SLOTS = 32;
+    static constexpr size_t AUDIO_SLOTS = 64;
+
+    // Largest data chunk a 32-bit RIFF size can describe, kept to whole
+    // stereo frames. Longer recordings continue in numbered files.
+    static constexpr uint64_t MAX_WAV_DATA_BYTES = (0xFFFFFFFFull - 36) & ~3ull;
+
+    void writerLoop();
+    bool drain();
+    void writeFrame(const VideoFrame& frame);
+    void writeAudio(const int16_t* samples, size_t count);
+    bool nextAudioFile();
+    void finishAudioFile();
+    void writeWavHeader(uint32_t dataBytes);
+
+    std::unique_ptr<SPSCQueue<VideoFrame, FRAME_SLOTS>> frames;
+    std::unique_ptr<SPSCQueue<AudioBlock, AUDIO_SLOTS>> audio;
+    std::vector<uint8_t> encoded;
+
+    std::ofstream videoFile;
+    std::ofstream audioFile;
+    std::string audioPath;
+    VideoFormat videoFormat = VideoFormat::Y4M;
+    bool capturingVideo = false;
+    bool capturingAudio = false;
+    uint64_t audioBytes = 0;
+    uint64_t audioSplitBytes = MAX_WAV_DATA_BYTES;
+    uint32_t audioPart = 0;
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerCondition;
+    bool stopping = false;
+
+    std::atomic<uint64_t> framesWritten{0};
+    std::atomic<uint64_t> droppedFrames{0};
+    std::atomic<uint64_t> droppedSamples{0};
+};
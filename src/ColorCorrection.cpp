@@ -0,0 +1,76 @@
+#include "ColorCorrection.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ColorCorrection {
+
+namespace {
+
+struct Screen {
+    double lcdGamma;
+    double outputGamma;
+    double luminance;
+    // Output red, green and blue as weights of the panel's red, green, blue.
+    double mix[3][3];
+};
+
+// The original GBA panel is dark and its primaries bleed into each other; the
+// frontlit SP is brighter and closer to sRGB.
+constexpr Screen GBA_SCREEN = {
+    4.0, 2.2, 255.0 / 280.0,
+    {{255.0 / 255.0, 50.0 / 255.0, 0.0},
+     {10.0 / 255.0, 230.0 / 255.0, 30.0 / 255.0},
+     {50.0 / 255.0, 10.0 / 255.0, 220.0 / 255.0}}};
+
+constexpr Screen GBA_SP_SCREEN = {
+    2.6, 2.2, 1.0,
+    {{0.86, 0.10, 0.04},
+     {0.03, 0.90, 0.07},
+     {0.02, 0.12, 0.86}}};
+
+uint8_t encode(double linear, const Screen& screen) {
+    double value = std::pow(std::max(linear, 0.0), 1.0 / screen.outputGamma) * screen.luminance;
+    return static_cast<uint8_t>(std::clamp(std::lround(value * 255.0), 0L, 255L));
+}
+}
+
+uint32_t toARGB(uint16_t color, ColorProfile profile) {
+    if (profile == ColorProfile::None) {
+        uint8_t r = (color & 0x1F) << 3;
+        uint8_t g = ((color >> 5) & 0x1F) << 3;
+        uint8_t b = ((color >> 10) & 0x1F) << 3;
+        return 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+
+    const Screen& screen = profile == ColorProfile::GBA ? GBA_SCREEN : GBA_SP_SCREEN;
+    double panel[3] = {
+        std::pow((color & 0x1F) / 31.0, screen.lcdGamma),
+        std::pow(((color >> 5) & 0x1F) / 31.0, screen.lcdGamma),
+        std::pow(((color >> 10) & 0x1F) / 31.0, screen.lcdGamma)
+    };
+
+    uint32_t argb = 0xFF000000;
+    for (int channel = 0; channel < 3; channel++) {
+        const double* weights = screen.mix[channel];
+        double linear = weights[0] * panel[0] + weights[1] * panel[1] + weights[2] * panel[2];
+        argb |= encode(linear, screen) << (16 - channel * 8);
+    }
+    return argb;
+}
+
+uint16_t toRGB565(uint16_t color, ColorProfile profile) {
+    if (profile == ColorProfile::None) {
+        uint16_t r = color & 0x1F;
+        uint16_t g = (color >> 5) & 0x1F;
+        uint16_t b = (color >> 10) & 0x1F;
+        return (r << 11) | (g << 6) | ((g >> 4) << 5) | b;
+    }
+
+    uint32_t argb = toARGB(color, profile);
+    uint16_t r = ((argb >> 16) & 0xFF) * 31 / 255;
+    uint16_t g = ((argb >> 8) & 0xFF) * 63 / 255;
+    uint16_t b = (argb & 0xFF) * 31 / 255;
+    return (r << 11) | (g << 5) | b;
+}
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include "FrameTarget.h"
+
+namespace ColorCorrection {
+
+// Converts a BGR555 color to ARGB8888 as it appears on the selected screen.
+// Meant for building lookup tables, not for per-pixel use.
+uint32_t toARGB(uint16_t color, ColorProfile profile);
+uint16_t toRGB565(uint16_t color, ColorProfile profile);
+
+}
@@ -0,0 +1,214 @@
+#include "Compositor.h"
+#include <algorithm>
+
+namespace Compositor {
+
+namespace {
+
+#ifdef PPU_USE_SSE2
+__m128i windowHidden(const uint8_t* window, int x, __m128i bit) {
+    __m128i mask = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(window + x)), _mm_setzero_si128());
+    return _mm_cmpeq_epi16(_mm_and_si128(mask, bit), _mm_setzero_si128());
+}
+
+__m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__m128i load(const uint16_t* data) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+void store(uint16_t* data, __m128i value) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(data), value);
+}
+
+void push(Line& line, int x, __m128i visible, __m128i color, __m128i flags) {
+    __m128i top = load(&line.top[x]);
+    __m128i topFlags = load(&line.topFlags[x]);
+    store(&line.second[x], select(visible, top, load(&line.second[x])));
+    store(&line.secondFlags[x], select(visible, topFlags, load(&line.secondFlags[x])));
+    store(&line.top[x], select(visible, color, top));
+    store(&line.topFlags[x], select(visible, flags, topFlags));
+}
+#endif
+
+void push(Line& line, int x, uint16_t color, uint16_t flags) {
+    line.second[x] = line.top[x];
+    line.secondFlags[x] = line.topFlags[x];
+    line.top[x] = color;
+    line.topFlags[x] = flags;
+}
+
+uint16_t blendAlpha(uint16_t a, uint16_t b, int eva, int evb) {
+    int r = std::min(31, ((a & 0x1F) * eva + (b & 0x1F) * evb) >> 4);
+    int g = std::min(31, (((a >> 5) & 0x1F) * eva + ((b >> 5) & 0x1F) * evb) >> 4);
+    int bl = std::min(31, (((a >> 10) & 0x1F) * eva + ((b >> 10) & 0x1F) * evb) >> 4);
+    return static_cast<uint16_t>(r | (g << 5) | (bl << 10));
+}
+
+uint16_t brighten(uint16_t c, int evy) {
+    int r = c & 0x1F;
+    int g = (c >> 5) & 0x1F;
+    int b = (c >> 10) & 0x1F;
+    r += ((31 - r) * evy) >> 4;
+    g += ((31 - g) * evy) >> 4;
+    b += ((31 - b) * evy) >> 4;
+    return static_cast<uint16_t>(r | (g << 5) | (b << 10));
+}
+
+uint16_t darken(uint16_t c, int evy) {
+    int r = c & 0x1F;
+    int g = (c >> 5) & 0x1F;
+    int b = (c >> 10) & 0x1F;
+    r -= (r * evy) >> 4;
+    g -= (g * evy) >> 4;
+    b -= (b * evy) >> 4;
+    return static_cast<uint16_t>(r | (g << 5) | (b << 10));
+}
+
+}
+
+void fill(Line& line, uint16_t backdrop, uint16_t flags) {
+    line.top.fill(backdrop);
+    line.second.fill(backdrop);
+    line.topFlags.fill(flags);
+    line.secondFlags.fill(0);
+}
+
+void overlayLayer(Line& line, const uint16_t* src, const uint8_t* window, uint8_t bit, uint16_t flags) {
+    int x = 0;
+#ifdef PPU_USE_SSE2
+    const __m128i windowBit = _mm_set1_epi16(bit);
+    const __m128i layerFlags = _mm_set1_epi16(static_cast<int16_t>(flags));
+    for (; x + 8 <= SCREEN_WIDTH; x += 8) {
+        __m128i color = load(src + x);
+        __m128i hidden = _mm_or_si128(_mm_srai_epi16(color, 15), windowHidden(window, x, windowBit));
+        push(line, x, _mm_xor_si128(hidden, _mm_set1_epi16(-1)), color, layerFlags);
+    }
+#endif
+    overlayLayerScalar(line, src, window, bit, flags, x, SCREEN_WIDTH);
+}
+
+void overlayLayerScalar(Line& line, const uint16_t* src, const uint8_t* window, uint8_t bit, uint16_t flags,
+                        int first, int last) {
+    for (int x = first; x < last; x++) {
+        if (!(src[x] & PIXEL_TRANSPARENT) && (window[x] & bit)) push(line, x, src[x], flags);
+    }
+}
+
+void overlayObjects(Line& line, const uint16_t* src, const uint16_t* priorities, int priority,
+                    const uint8_t* window, const uint8_t* semiTransparent, uint16_t flags) {
+    int x = 0;
+#ifdef PPU_USE_SSE2
+    const __m128i wanted = _mm_set1_epi16(static_cast<int16_t>(priority));
+    const __m128i windowBit = _mm_set1_epi16(0x10);
+    const __m128i layerFlags = _mm_set1_epi16(static_cast<int16_t>(flags));
+    for (; x + 8 <= SCREEN_WIDTH; x += 8) {
+        __m128i match = _mm_cmpeq_epi16(load(priorities + x), wanted);
+        match = _mm_andnot_si128(windowHidden(window, x, windowBit), match);
+        __m128i semi = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(semiTransparent + x)), _mm_setzero_si128());
+        __m128i pixelFlags = _mm_or_si128(layerFlags, _mm_slli_epi16(semi, 2));
+        push(line, x, match, load(src + x), pixelFlags);
+    }
+#endif
+    overlayObjectsScalar(line, src, priorities, priority, window, semiTransparent, flags, x, SCREEN_WIDTH);
+}
+
+void overlayObjectsScalar(Line& line, const uint16_t* src, const uint16_t* priorities, int priority,
+                          const uint8_t* window, const uint8_t* semiTransparent, uint16_t flags, int first, int last) {
+    for (int x = first; x < last; x++) {
+        if (priorities[x] == priority && (window[x] & 0x10)) {
+            push(line, x, src[x], flags | (semiTransparent[x] ? SEMI_TRANSPARENT : 0));
+        }
+    }
+}
+
+void applyEffects(Line& line, const uint8_t* window, const EffectParams& params) {
+    int x = 0;
+#ifdef PPU_USE_SSE2
+    int eva = std::min(params.eva, 16);
+    int evb = std::min(params.evb, 16);
+    int evy = std::min(params.evy, 16);
+    bool alphaMode = params.effect == Effect::Alpha;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i channel = _mm_set1_epi16(0x1F);
+    const __m128i maxChannel = _mm_set1_epi16(31);
+    const __m128i effectsBit = _mm_set1_epi16(WINDOW_EFFECTS);
+    const __m128i first = _mm_set1_epi16(TARGET_FIRST);
+    const __m128i second = _mm_set1_epi16(TARGET_SECOND);
+    const __m128i alphaWanted = _mm_set1_epi16(alphaMode ? (TARGET_FIRST | SEMI_TRANSPARENT) : SEMI_TRANSPARENT);
+    const __m128i factorA = _mm_set1_epi16(static_cast<int16_t>(eva));
+    const __m128i factorB = _mm_set1_epi16(static_cast<int16_t>(evb));
+    const __m128i factorY = _mm_set1_epi16(static_cast<int16_t>(evy));
+    const bool brightness = params.effect == Effect::Brighten || params.effect == Effect::Darken;
+    const bool increase = params.effect == Effect::Brighten;
+
+    auto split = [&](__m128i c, __m128i& r, __m128i& g, __m128i& b) {
+        r = _mm_and_si128(c, channel);
+        g = _mm_and_si128(_mm_srli_epi16(c, 5), channel);
+        b = _mm_and_si128(_mm_srli_epi16(c, 10), channel);
+    };
+    auto join = [](__m128i r, __m128i g, __m128i b) {
+        return _mm_or_si128(r, _mm_or_si128(_mm_slli_epi16(g, 5), _mm_slli_epi16(b, 10)));
+    };
+    auto mix = [&](__m128i a, __m128i b) {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, factorA), _mm_mullo_epi16(b, factorB));
+        return _mm_min_epi16(_mm_srli_epi16(sum, 4), maxChannel);
+    };
+    auto fade = [&](__m128i c) {
+        if (increase) {
+            return _mm_add_epi16(c, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(maxChannel, c), factorY), 4));
+        }
+        return _mm_sub_epi16(c, _mm_srli_epi16(_mm_mullo_epi16(c, factorY), 4));
+    };
+
+    for (; x + 8 <= SCREEN_WIDTH; x += 8) {
+        __m128i topFlags = load(&line.topFlags[x]);
+        __m128i enabled = _mm_xor_si128(windowHidden(window, x, effectsBit), _mm_set1_epi16(-1));
+        __m128i alpha = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(topFlags, alphaWanted), zero), enabled);
+        alpha = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(load(&line.secondFlags[x]), second), zero), alpha);
+
+        __m128i top = load(&line.top[x]);
+        __m128i r, g, b;
+        split(top, r, g, b);
+
+        __m128i result = top;
+        if (brightness) {
+            __m128i faded = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(topFlags, first), zero), enabled);
+            result = select(faded, join(fade(r), fade(g), fade(b)), result);
+        }
+
+        __m128i r2, g2, b2;
+        split(load(&line.second[x]), r2, g2, b2);
+        result = select(alpha, join(mix(r, r2), mix(g, g2), mix(b, b2)), result);
+
+        store(&line.top[x], result);
+    }
+#endif
+    applyEffectsScalar(line, window, params, x, SCREEN_WIDTH);
+}
+
+void applyEffectsScalar(Line& line, const uint8_t* window, const EffectParams& params, int first, int last) {
+    int eva = std::min(params.eva, 16);
+    int evb = std::min(params.evb, 16);
+    int evy = std::min(params.evy, 16);
+    bool alphaMode = params.effect == Effect::Alpha;
+
+    for (int x = first; x < last; x++) {
+        if (!(window[x] & WINDOW_EFFECTS)) continue;
+
+        uint16_t flags = line.topFlags[x];
+        bool wantsAlpha = (flags & SEMI_TRANSPARENT) || (alphaMode && (flags & TARGET_FIRST));
+        if (wantsAlpha && (line.secondFlags[x] & TARGET_SECOND)) {
+            line.top[x] = blendAlpha(line.top[x], line.second[x], eva, evb);
+        } else if ((flags & TARGET_FIRST) && params.effect == Effect::Brighten) {
+            line.top[x] = brighten(line.top[x], evy);
+        } else if ((flags & TARGET_FIRST) && params.effect == Effect::Darken) {
+            line.top[x] = darken(line.top[x], evy);
+        }
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include "Renderer.h"
+
+namespace Compositor {
+
+constexpr uint16_t TARGET_FIRST = 0x1;
+constexpr uint16_t TARGET_SECOND = 0x2;
+constexpr uint16_t SEMI_TRANSPARENT = 0x4;
+
+enum class Effect {
+    None = 0,
+    Alpha = 1,
+    Brighten = 2,
+    Darken = 3
+};
+
+struct Line {
+    alignas(16) LineBuffer top;
+    alignas(16) LineBuffer second;
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH> topFlags;
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH> secondFlags;
+};
+
+struct EffectParams {
+    Effect effect = Effect::None;
+    int eva = 0;
+    int evb = 0;
+    int evy = 0;
+};
+
+void fill(Line& line, uint16_t backdrop, uint16_t flags);
+void overlayLayer(Line& line, const uint16_t* src, const uint8_t* window, uint8_t bit, uint16_t flags);
+void overlayObjects(Line& line, const uint16_t* src, const uint16_t* priorities, int priority,
+                    const uint8_t* window, const uint8_t* semiTransparent, uint16_t flags);
+void applyEffects(Line& line, const uint8_t* window, const EffectParams& params);
+
+// Per-pixel versions over [first, last); they finish the rows the vector
+// paths leave over and define the result those paths must reproduce.
+void overlayLayerScalar(Line& line, const uint16_t* src, const uint8_t* window, uint8_t bit, uint16_t flags,
+                        int first, int last);
+void overlayObjectsScalar(Line& line, const uint16_t* src, const uint16_t* priorities, int priority,
+                          const uint8_t* window, const uint8_t* semiTransparent, uint16_t flags, int first, int last);
+void applyEffectsScalar(Line& line, const uint8_t* window, const EffectParams& params, int first, int last);
+
+}
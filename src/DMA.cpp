@@ -1,10 +1,25 @@
 #include "DMA.h"
 #include "MMU.h"
+#include "EEPROM.h"
 
 DMA::DMA(MMU& mmu) : mmu(mmu) {
+    connectIO();
     reset();
 }
 
+void DMA::connectIO() {
+    for (int i = 0; i < 4; i++) {
+        uint32_t base = 0x040000B0 + i * 12;
+        mmu.setIOWriteHandler(base, [this, i](uint16_t value) { writeSource(i, value, false); });
+        mmu.setIOWriteHandler(base + 2, [this, i](uint16_t value) { writeSource(i, value, true); });
+        mmu.setIOWriteHandler(base + 4, [this, i](uint16_t value) { writeDest(i, value, false); });
+        mmu.setIOWriteHandler(base + 6, [this, i](uint16_t value) { writeDest(i, value, true); });
+        mmu.setIOWriteHandler(base + 8, [this, i](uint16_t value) { writeCount(i, value); });
+        mmu.setIOReadHandler(base + 10, [this, i]() { return readControl(i); });
+        mmu.setIOWriteHandler(base + 10, [this, i](uint16_t value) { writeControl(i, value); });
+    }
+}
+
 void DMA::reset() {
     source.fill(0);
     dest.fill(0);
@@ -63,17 +78,25 @@ void DMA::execute(int channel) {
     if (dstMode == 1) dstIncrement = -dstIncrement;
     else if (dstMode == 2) dstIncrement = 0;
     
-    for (uint32_t i = 0; i < transferCount; i++) {
-        if (is32bit) {
-            uint32_t value = mmu.read32(internalSource[channel]);
-            mmu.write32(internalDest[channel], value);
-        } else {
-            uint16_t value = mmu.read16(internalSource[channel]);
-            mmu.write16(internalDest[channel], value);
+    if (channel == 3 && !is32bit && transferCount <= EEPROM::MAX_COMMAND_BITS &&
+        mmu.isEEPROMAccess(internalDest[channel])) {
+        transferToEEPROM(channel, transferCount, srcIncrement);
+    } else if (channel == 3 && !is32bit && transferCount <= EEPROM::MAX_COMMAND_BITS &&
+               mmu.isEEPROMAccess(internalSource[channel])) {
+        transferFromEEPROM(channel, transferCount, dstIncrement);
+    } else {
+        for (uint32_t i = 0; i < transferCount; i++) {
+            if (is32bit) {
+                uint32_t value = mmu.read32(internalSource[channel]);
+                mmu.write32(internalDest[channel], value);
+            } else {
+                uint16_t value = mmu.read16(internalSource[channel]);
+                mmu.write16(internalDest[channel], value);
+            }
+            
+            internalSource[channel] += srcIncrement;
+            internalDest[channel] += dstIncrement;
         }
-        
-        internalSource[channel] += srcIncrement;
-        internalDest[channel] += dstIncrement;
     }
     
     if (control[channel] & 0x4000) {
@@ -90,6 +113,24 @@ void DMA::execute(int channel) {
     }
 }
 
+void DMA::transferToEEPROM(int channel, uint32_t transferCount, int srcIncrement) {
+    std::array<uint8_t, EEPROM::MAX_COMMAND_BITS> bits{};
+    for (uint32_t i = 0; i < transferCount; i++) {
+        bits[i] = mmu.read16(internalSource[channel]) & 1;
+        internalSource[channel] += srcIncrement;
+    }
+    mmu.getEEPROM().writeCommand(bits.data(), transferCount);
+}
+
+void DMA::transferFromEEPROM(int channel, uint32_t transferCount, int dstIncrement) {
+    std::array<uint8_t, EEPROM::MAX_COMMAND_BITS> bits{};
+    mmu.getEEPROM().readBits(bits.data(), transferCount);
+    for (uint32_t i = 0; i < transferCount; i++) {
+        mmu.write16(internalDest[channel], bits[i]);
+        internalDest[channel] += dstIncrement;
+    }
+}
+
 uint32_t DMA::readSource(int channel) const {
     return source[channel];
 }
@@ -33,7 +33,10 @@ public:
     void writeControl(int channel, uint16_t value);
     
 private:
+    void connectIO();
     void execute(int channel);
+    void transferToEEPROM(int channel, uint32_t transferCount, int srcIncrement);
+    void transferFromEEPROM(int channel, uint32_t transferCount, int dstIncrement);
     
     MMU& mmu;
     
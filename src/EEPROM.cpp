@@ -0,0 +1,130 @@
+#include "EEPROM.h"
+
+EEPROM::EEPROM() {
+    reset();
+}
+
+void EEPROM::reset() {
+    memory.fill(0, memory.size(), 0xFF);
+    size = EEPROMSize::EEPROM512;
+    commandBits = 0;
+    readAddress = 0;
+    readPosition = READ_BITS;
+}
+
+bool EEPROM::mapSaveFile(const std::string& path) {
+    pendingPath.clear();
+    size_t existing = SaveFile::existingSize(path);
+    if (existing == 0) {
+        memory.reset();
+        pendingPath = path;
+        return true;
+    }
+
+    size = existing == 0x200 ? EEPROMSize::EEPROM512 : EEPROMSize::EEPROM8K;
+    return memory.map(path, existing == 0x200 ? 0x200 : 0x2000);
+}
+
+void EEPROM::createPendingFile() {
+    if (pendingPath.empty()) return;
+
+    memory.map(pendingPath, size == EEPROMSize::EEPROM8K ? 0x2000 : 0x200);
+    pendingPath.clear();
+}
+
+uint16_t EEPROM::read() {
+    if (readPosition >= READ_BITS) {
+        return 1;
+    }
+
+    uint32_t position = readPosition++;
+    if (position < 4) {
+        return 0;
+    }
+
+    uint32_t bit = position - 4;
+    return (memory[readAddress + bit / 8] >> (7 - (bit & 7))) & 1;
+}
+
+void EEPROM::write(uint16_t value) {
+    command[commandBits++] = value & 1;
+
+    if (commandBits < 2) return;
+
+    bool isRead = command[0] && command[1];
+    uint32_t length = 2 + addressBits() + 1;
+    if (!isRead) length += 64;
+
+    if (commandBits >= length || commandBits >= MAX_COMMAND_BITS) {
+        if (commandBits == length) {
+            createPendingFile();
+            execute(command.data());
+        }
+        commandBits = 0;
+    }
+}
+
+void EEPROM::writeCommand(const uint8_t* bits, uint32_t count) {
+    if (commandBits == 0 && detectSize(count)) {
+        createPendingFile();
+        execute(bits);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        write(bits[i]);
+    }
+}
+
+void EEPROM::readBits(uint8_t* bits, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        bits[i] = read();
+    }
+}
+
+bool EEPROM::detectSize(uint32_t count) {
+    switch (count) {
+        case 2 + 6 + 1:
+        case 2 + 6 + 64 + 1:
+            size = EEPROMSize::EEPROM512;
+            return true;
+        case 2 + 14 + 1:
+        case 2 + 14 + 64 + 1:
+            size = EEPROMSize::EEPROM8K;
+            return true;
+    }
+    return false;
+}
+
+uint32_t EEPROM::decodeAddress(const uint8_t* bits) const {
+    uint32_t block = 0;
+    for (int i = 0; i < addressBits(); i++) {
+        block = (block << 1) | bits[2 + i];
+    }
+    block &= (size == EEPROMSize::EEPROM8K) ? 0x3FF : 0x3F;
+    return block * 8;
+}
+
+void EEPROM::execute(const uint8_t* bits) {
+    if (!bits[0]) return;
+
+    uint32_t address = decodeAddress(bits);
+    if (address + 8 > memory.size()) return;
+
+    if (bits[1]) {
+        readAddress = address;
+        readPosition = 0;
+        return;
+    }
+
+    const uint8_t* data = bits + 2 + addressBits();
+    for (int i = 0; i < 8; i++) {
+        uint8_t byte = 0;
+        for (int b = 0; b < 8; b++) {
+            byte = (byte << 1) | data[i * 8 + b];
+        }
+        memory[address + i] = byte;
+    }
+    memory.markDirty(address);
+    readPosition = READ_BITS;
+}
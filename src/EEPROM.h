@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+#include "SaveFile.h"
+
+enum class EEPROMSize {
+    EEPROM512,
+    EEPROM8K
+};
+
+class EEPROM {
+public:
+    EEPROM();
+
+    void reset();
+
+    uint16_t read();
+    void write(uint16_t value);
+
+    void writeCommand(const uint8_t* bits, uint32_t count);
+    void readBits(uint8_t* bits, uint32_t count);
+
+    EEPROMSize getSize() const { return size; }
+    bool mapSaveFile(const std::string& path);
+
+    static constexpr uint32_t MAX_COMMAND_BITS = 2 + 14 + 64 + 1;
+    static constexpr uint32_t READ_BITS = 4 + 64;
+
+private:
+    int addressBits() const { return size == EEPROMSize::EEPROM8K ? 14 : 6; }
+    bool detectSize(uint32_t count);
+    void createPendingFile();
+    void execute(const uint8_t* bits);
+    uint32_t decodeAddress(const uint8_t* bits) const;
+
+    EEPROMSize size = EEPROMSize::EEPROM512;
+
+    // A new save file is only created once the first command shows the part size.
+    std::string pendingPath;
+
+    std::array<uint8_t, MAX_COMMAND_BITS> command{};
+    uint32_t commandBits = 0;
+
+    uint32_t readAddress = 0;
+    uint32_t readPosition = READ_BITS;
+
+    SaveFile memory{0x2000};
+};
@@ -5,7 +5,7 @@ Flash::Flash(FlashSize size) : flashSize(size) {
 }
 
 void Flash::reset() {
-    memory.fill(0xFF);
+    memory.fill(0, memory.size(), 0xFF);
     state = FlashState::Ready;
     currentBank = 0;
     chipIdMode = false;
@@ -15,6 +15,10 @@ void Flash::setSize(FlashSize size) {
     flashSize = size;
 }
 
+bool Flash::mapSaveFile(const std::string& path) {
+    return memory.map(path, (flashSize == FlashSize::Flash128K) ? 0x20000 : 0x10000);
+}
+
 uint8_t Flash::read(uint32_t address) {
     address &= 0xFFFF;
     
@@ -96,6 +100,7 @@ void Flash::write(uint32_t address, uint8_t value) {
             }
             if (fullAddr < memory.size()) {
                 memory[fullAddr] &= value;
+                memory.markDirty(fullAddr);
             }
             state = FlashState::Ready;
             break;
@@ -152,18 +157,9 @@ void Flash::handleCommand(uint32_t address, uint8_t value) {
 
 void Flash::eraseChip() {
     size_t eraseSize = (flashSize == FlashSize::Flash128K) ? 0x20000 : 0x10000;
-    for (size_t i = 0; i < eraseSize; i++) {
-        memory[i] = 0xFF;
-    }
+    memory.fill(0, eraseSize, 0xFF);
 }
 
 void Flash::eraseSector(uint32_t sector) {
-    uint32_t start = sector * 0x1000;
-    uint32_t end = start + 0x1000;
-    
-    if (end > memory.size()) end = memory.size();
-    
-    for (uint32_t i = start; i < end; i++) {
-        memory[i] = 0xFF;
-    }
+    memory.fill(sector * 0x1000, 0x1000, 0xFF);
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
-#include <array>
+#include <cstddef>
+#include <string>
+#include "SaveFile.h"
 
 enum class FlashState {
     Ready,
@@ -30,6 +32,7 @@ public:
     void write(uint32_t address, uint8_t value);
     
     void setSize(FlashSize size);
+    bool mapSaveFile(const std::string& path);
     
 private:
     void handleCommand(uint32_t address, uint8_t value);
@@ -42,7 +45,7 @@ private:
     uint8_t currentBank = 0;
     bool chipIdMode = false;
     
-    std::array<uint8_t, 0x20000> memory{};
+    SaveFile memory{0x20000};
     
     static constexpr uint16_t MANUFACTURER_ID = 0x32;
     static constexpr uint16_t DEVICE_ID_64K = 0x1B;
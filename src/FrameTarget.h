@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PixelFormat : uint8_t {
+    ARGB8888 = 0,
+    RGB565 = 1,
+    BGR555 = 2
+};
+
+enum class ColorProfile : uint8_t {
+    None = 0,
+    GBA = 1,
+    GBASP = 2
+};
+
+struct FrameTarget {
+    void* pixels = nullptr;
+    int pitch = 0;
+    PixelFormat format = PixelFormat::ARGB8888;
+};
+
+struct LineRange {
+    int first = 0;
+    int count = 0;
+};
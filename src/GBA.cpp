@@ -5,6 +5,8 @@
 #include "Timer.h"
 #include "DMA.h"
 #include "APU.h"
+#include "SharedExport.h"
+#include <filesystem>
 
 GBA::GBA() {
     mmu = std::make_unique<MMU>();
@@ -23,6 +25,7 @@ bool GBA::loadROM(const std::string& path) {
     if (!mmu->loadROM(path)) {
         return false;
     }
+    mmu->loadSaveFile(std::filesystem::path(path).replace_extension(".sav").string());
     reset();
     return true;
 }
@@ -37,6 +40,7 @@ void GBA::reset() {
 
 void GBA::runFrame() {
     ppu->clearFrameReady();
+    apu->clearSampleBuffer();
 
     while (!ppu->isFrameReady()) {
         cpu->step();
@@ -45,12 +49,23 @@ void GBA::runFrame() {
         ppu->step(1);
         cpu->checkIRQ();
     }
+
+    if (sharedExport) {
+        const FrameTarget& output = ppu->getFrameOutput();
+        const std::vector<int16_t>& samples = apu->getSampleBuffer();
+        sharedExport->publishFrame(output.pixels, output.pitch, output.format);
+        sharedExport->publishAudio(samples.data(), samples.size());
+    }
 }
 
 const uint32_t* GBA::getFramebuffer() const {
     return ppu->getFramebuffer();
 }
 
+void GBA::setFrameTarget(void* pixels, int pitch, PixelFormat format) {
+    ppu->setFrameTarget({pixels, pitch, format});
+}
+
 bool GBA::isFrameReady() const {
     return ppu->isFrameReady();
 }
@@ -59,6 +74,45 @@ void GBA::clearFrameReady() {
     ppu->clearFrameReady();
 }
 
+void GBA::setRenderThreads(int count) {
+    ppu->setRenderThreads(count);
+}
+
+void GBA::setLineSkipping(bool enabled) {
+    ppu->setLineSkipping(enabled);
+}
+
+void GBA::setColorProfile(ColorProfile profile) {
+    ppu->setColorProfile(profile);
+}
+
+LineSkipStats GBA::getLineSkipStats() const {
+    return ppu->getLineSkipStats();
+}
+
+const std::vector<LineRange>& GBA::getDirtyLines() const {
+    return ppu->getDirtyLines();
+}
+
+const std::vector<int16_t>& GBA::getAudioSamples() const {
+    return apu->getSampleBuffer();
+}
+
+void GBA::clearAudioSamples() {
+    apu->clearSampleBuffer();
+}
+
+bool GBA::openSharedExport(const std::string& name) {
+    auto region = std::make_unique<SharedExport>();
+    if (!region->open(name, APU::SAMPLE_RATE)) return false;
+    sharedExport = std::move(region);
+    return true;
+}
+
+void GBA::closeSharedExport() {
+    sharedExport.reset();
+}
+
 void GBA::updateKey(int id, bool pressed) {
     static uint16_t currentKeys = 0x03FF;
     if (pressed) {
@@ -80,3 +134,36 @@ uint16_t GBA::getIME() const {
 uint16_t GBA::getIE() const {
     return mmu->getIE();
 }
+
+bool GBA::addWatchpoint(uint32_t address, uint32_t length, WatchType type) {
+#ifdef GBA_WATCHPOINTS
+    mmu->addWatchpoint(address, length, type);
+    return true;
+#else
+    (void)address;
+    (void)length;
+    (void)type;
+    return false;
+#endif
+}
+
+void GBA::removeWatchpoint(uint32_t address) {
+    mmu->removeWatchpoint(address);
+}
+
+void GBA::clearWatchpoints() {
+    mmu->clearWatchpoints();
+}
+
+bool GBA::setAccessTrace(bool enabled) {
+#ifdef GBA_WATCHPOINTS
+    mmu->setAccessTrace(enabled);
+    return true;
+#else
+    return !enabled;
+#endif
+}
+
+void GBA::setWatchCallback(WatchCallback callback) {
+    mmu->setWatchCallback(std::move(callback));
+}
@@ -2,6 +2,9 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include "Watchpoint.h"
+#include "FrameTarget.h"
 
 class CPU;
 class MMU;
@@ -9,6 +12,8 @@ class PPU;
 class Timer;
 class DMA;
 class APU;
+class SharedExport;
+struct LineSkipStats;
 
 class GBA {
 public:
@@ -20,15 +25,34 @@ public:
     void runFrame();
 
     const uint32_t* getFramebuffer() const;
+    void setFrameTarget(void* pixels, int pitch, PixelFormat format);
     bool isFrameReady() const;
     void clearFrameReady();
 
     void updateKey(int id, bool pressed);
+    void setRenderThreads(int count);
+    void setLineSkipping(bool enabled);
+    void setColorProfile(ColorProfile profile);
+    LineSkipStats getLineSkipStats() const;
+    const std::vector<LineRange>& getDirtyLines() const;
+
+    // Interleaved stereo samples generated by the last runFrame(); each call starts a new batch.
+    const std::vector<int16_t>& getAudioSamples() const;
+    void clearAudioSamples();
+
+    bool openSharedExport(const std::string& name);
+    void closeSharedExport();
     
     uint16_t getDISPCNT() const;
     uint16_t getIME() const;
     uint16_t getIE() const;
 
+    bool addWatchpoint(uint32_t address, uint32_t length, WatchType type);
+    void removeWatchpoint(uint32_t address);
+    void clearWatchpoints();
+    bool setAccessTrace(bool enabled);
+    void setWatchCallback(WatchCallback callback);
+
 private:
     std::unique_ptr<MMU> mmu;
     std::unique_ptr<CPU> cpu;
@@ -36,4 +60,5 @@ private:
     std::unique_ptr<Timer> timer;
     std::unique_ptr<DMA> dma;
     std::unique_ptr<APU> apu;
+    std::unique_ptr<SharedExport> sharedExport;
 };
@@ -0,0 +1,198 @@
+#include "LineSignatures.h"
+#include "MMU.h"
+#include "Utils.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+uint64_t hashState(const RenderState& state) {
+    uint64_t hash = Utils::hashCombine(0, state.videoMode | (state.frameSelect << 3) | (state.objMapping1D << 4) |
+                                              (state.hblankIntervalFree << 5) | (state.layerEnable << 8) |
+                                              (state.windowEnable << 16));
+    for (int bg = 0; bg < 4; bg++) {
+        const BackgroundControl& control = state.bgControl[bg];
+        hash = Utils::hashCombine(hash, control.priority | (control.mosaic << 2) | (control.color256 << 3) |
+                                            (control.wraparound << 4) | (control.screenSize << 5));
+        hash = Utils::hashCombine(hash, control.charBase | (static_cast<uint64_t>(control.screenBase) << 32));
+        hash = Utils::hashCombine(hash, state.bgHOffset[bg] | (state.bgVOffset[bg] << 16));
+    }
+    for (const AffineParams& affine : state.bgAffine) {
+        hash = Utils::hashCombine(hash, static_cast<uint16_t>(affine.pa) | (static_cast<uint16_t>(affine.pb) << 16) |
+                                            (static_cast<uint64_t>(static_cast<uint16_t>(affine.pc)) << 32) |
+                                            (static_cast<uint64_t>(static_cast<uint16_t>(affine.pd)) << 48));
+        hash = Utils::hashCombine(hash, static_cast<uint32_t>(affine.currentX) |
+                                            (static_cast<uint64_t>(static_cast<uint32_t>(affine.currentY)) << 32));
+    }
+    hash = Utils::hashCombine(hash, state.winH[0] | (state.winH[1] << 16) |
+                                        (static_cast<uint64_t>(state.winV[0]) << 32) |
+                                        (static_cast<uint64_t>(state.winV[1]) << 48));
+    hash = Utils::hashCombine(hash, state.winIn | (state.winOut << 16) |
+                                        (static_cast<uint64_t>(state.mosaic) << 32));
+    hash = Utils::hashCombine(hash, state.blendControl | (state.blendAlpha << 16) |
+                                        (static_cast<uint64_t>(state.blendBrightness) << 32));
+    return hash;
+}
+}
+
+void LineSignatures::reset(MMU& mmu) {
+    std::memcpy(vram.data(), mmu.getVRAM(), vram.size());
+    std::memcpy(oam.data(), mmu.getOAM(), oam.size());
+    std::memcpy(palette.data(), mmu.getPalette(), palette.size());
+
+    for (uint32_t& generation : vramBlocks) generation++;
+    for (uint32_t& generation : charBlocks) generation++;
+    for (uint32_t& generation : objLines) generation++;
+    objTiles++;
+    bgPalette++;
+    objPalette++;
+}
+
+void LineSignatures::update(MMU& mmu) {
+    if (mmu.getVRAMDirty().any()) trackVRAM(mmu);
+    if (mmu.getOAMDirty().any()) trackOAM(mmu);
+    if (mmu.getPaletteDirty().any()) trackPalette(mmu);
+}
+
+void LineSignatures::trackVRAM(MMU& mmu) {
+    const VRAMDirtyBitmap& dirty = mmu.getVRAMDirty();
+    const uint8_t* live = mmu.getVRAM();
+
+    for (size_t word = 0; word < VRAMDirtyBitmap::WORDS; word++) {
+        for (uint64_t bits = dirty.word(word); bits; bits &= bits - 1) {
+            uint32_t offset = static_cast<uint32_t>(word * 64 + std::countr_zero(bits)) * 32;
+            if (std::memcmp(&vram[offset], live + offset, 32) == 0) continue;
+
+            std::memcpy(&vram[offset], live + offset, 32);
+            vramBlocks[offset / VRAM_BLOCK_SIZE]++;
+            if (offset < 0x10000) {
+                charBlocks[offset >> 14]++;
+            } else {
+                objTiles++;
+            }
+        }
+    }
+}
+
+void LineSignatures::trackOAM(MMU& mmu) {
+    const OAMDirtyBitmap& dirty = mmu.getOAMDirty();
+    const uint8_t* live = mmu.getOAM();
+
+    for (size_t index = 0; index < OAM_ENTRY_COUNT; index++) {
+        if (!dirty.test(index)) continue;
+
+        uint8_t* entry = &oam[index * 8];
+        if (std::memcmp(entry, live + index * 8, 8) == 0) continue;
+
+        if (std::memcmp(entry + 6, live + index * 8 + 6, 2) != 0) {
+            for (uint32_t& generation : objLines) generation++;
+        }
+        markObjectLines(entry);
+        std::memcpy(entry, live + index * 8, 8);
+        markObjectLines(entry);
+    }
+}
+
+void LineSignatures::trackPalette(MMU& mmu) {
+    const PaletteDirtyBitmap& dirty = mmu.getPaletteDirty();
+    const uint8_t* live = mmu.getPalette();
+
+    for (size_t bank = 0; bank < PALETTE_BANK_COUNT; bank++) {
+        if (!dirty.test(bank) || std::memcmp(&palette[bank * 32], live + bank * 32, 32) == 0) continue;
+
+        std::memcpy(&palette[bank * 32], live + bank * 32, 32);
+        if (bank < 16) {
+            bgPalette++;
+        } else {
+            objPalette++;
+        }
+    }
+}
+
+void LineSignatures::markObjectLines(const uint8_t* entry) {
+    uint16_t attr0 = entry[0] | (entry[1] << 8);
+    uint16_t attr1 = entry[2] | (entry[3] << 8);
+
+    bool affine = (attr0 >> 8) & 1;
+    int shape = (attr0 >> 14) & 3;
+    if ((!affine && ((attr0 >> 9) & 1)) || shape == 3) return;
+
+    int height = OBJ_HEIGHTS[shape][(attr1 >> 14) & 3] << ((affine && ((attr0 >> 9) & 1)) ? 1 : 0);
+    int y = attr0 & 0xFF;
+    if (y >= SCREEN_HEIGHT) y -= 256;
+
+    for (int line = std::max(y, 0); line < std::min(y + height, SCREEN_HEIGHT); line++) {
+        objLines[line]++;
+    }
+}
+
+uint64_t LineSignatures::vramRange(uint32_t start, uint32_t length) const {
+    uint64_t hash = 0;
+    uint32_t last = std::min((start + length - 1) / VRAM_BLOCK_SIZE, VRAM_BLOCK_COUNT - 1);
+    for (uint32_t block = start / VRAM_BLOCK_SIZE; block <= last; block++) {
+        hash = Utils::hashCombine(hash, vramBlocks[block]);
+    }
+    return hash;
+}
+
+uint64_t LineSignatures::backgroundDependencies(const RenderState& state, int bg, int line) const {
+    const BackgroundControl& control = state.bgControl[bg];
+    uint32_t page = state.frameSelect ? 0xA000 : 0;
+
+    switch (state.videoMode) {
+        case 3:
+            return vramRange(line * SCREEN_WIDTH * 2, SCREEN_WIDTH * 2);
+        case 4:
+            return vramRange(page + line * SCREEN_WIDTH, SCREEN_WIDTH);
+        case 5:
+            return line < 128 ? vramRange(page + line * 320, 320) : 0;
+    }
+
+    int charBlock = control.charBase >> 14;
+    uint64_t hash = 0;
+
+    if (state.videoMode == 2 || (state.videoMode == 1 && bg >= 2)) {
+        uint32_t mapBytes = 256u << (control.screenSize * 2);
+        hash = Utils::hashCombine(hash, charBlocks[charBlock]);
+        return Utils::hashCombine(hash, vramRange(control.screenBase, mapBytes));
+    }
+
+    int lastBlock = control.color256 ? 3 : std::min(charBlock + 1, 3);
+    for (int block = charBlock; block <= lastBlock; block++) {
+        hash = Utils::hashCombine(hash, charBlocks[block]);
+    }
+
+    int height = (control.screenSize & 2) ? 512 : 256;
+    int blockY = ((line + state.bgVOffset[bg]) % height) / 256;
+    int rowBlock = (control.screenSize == 3) ? blockY * 2 : (control.screenSize == 2 ? blockY : 0);
+    int blocks = (control.screenSize & 1) ? 2 : 1;
+    return Utils::hashCombine(hash, vramRange(control.screenBase + rowBlock * VRAM_BLOCK_SIZE, blocks * VRAM_BLOCK_SIZE));
+}
+
+uint64_t LineSignatures::compute(const FrameLog& log, int line) {
+    const LineRecord& record = log.lines[line];
+    const RenderState& state = record.state;
+
+    uint64_t hash = Utils::hashCombine(hashState(state), bgPalette);
+    uint8_t layers = state.activeLayers();
+
+    for (int bg = 0; bg < 4; bg++) {
+        if (!(layers & (1 << bg))) continue;
+
+        int source = record.mosaicSource[bg];
+        if (source >= 0) {
+            hash = Utils::hashCombine(hash, lines[source] ^ (static_cast<uint64_t>(source) << 56));
+        } else {
+            hash = Utils::hashCombine(hash, backgroundDependencies(state, bg, line));
+        }
+    }
+
+    if (layers & 0x10) {
+        hash = Utils::hashCombine(hash, objLines[line] | (static_cast<uint64_t>(objTiles) << 32));
+        hash = Utils::hashCombine(hash, objPalette);
+    }
+
+    lines[line] = hash | 1;
+    return lines[line];
+}
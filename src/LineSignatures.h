@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include "Renderer.h"
+
+class MMU;
+
+class LineSignatures {
+public:
+    void reset(MMU& mmu);
+    void update(MMU& mmu);
+    uint64_t compute(const FrameLog& log, int line);
+
+private:
+    void trackVRAM(MMU& mmu);
+    void trackOAM(MMU& mmu);
+    void trackPalette(MMU& mmu);
+    void markObjectLines(const uint8_t* entry);
+    uint64_t backgroundDependencies(const RenderState& state, int bg, int line) const;
+    uint64_t vramRange(uint32_t start, uint32_t length) const;
+
+    static constexpr uint32_t VRAM_BLOCK_SIZE = 0x800;
+    static constexpr uint32_t VRAM_BLOCK_COUNT = 0x18000 / VRAM_BLOCK_SIZE;
+
+    std::array<uint8_t, 0x18000> vram{};
+    std::array<uint8_t, 0x400> oam{};
+    std::array<uint8_t, 0x400> palette{};
+
+    std::array<uint32_t, VRAM_BLOCK_COUNT> vramBlocks{};
+    std::array<uint32_t, 4> charBlocks{};
+    uint32_t objTiles = 0;
+    std::array<uint32_t, SCREEN_HEIGHT> objLines{};
+    uint32_t bgPalette = 0;
+    uint32_t objPalette = 0;
+
+    std::array<uint64_t, SCREEN_HEIGHT> lines{};
+};
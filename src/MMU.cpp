@@ -5,18 +5,32 @@
 #include <iostream>
 
 MMU::MMU() {
+    installDefaultIOHandlers();
     reset();
 }
 
+void MMU::installDefaultIOHandlers() {
+    setIOReadHandler(0x04000130, [this]() { return keyInput; });
+
+    setIOReadHandler(0x04000202, [this]() { return interruptFlags; });
+    setIOWriteHandler(0x04000202, [this](uint16_t value) {
+        interruptFlags &= ~value;
+    }, ByteMerge::Clear);
+}
+
 void MMU::reset() {
     bios.fill(0);
     ewram.fill(0);
     iwram.fill(0);
     io.fill(0);
+    interruptFlags = 0;
     palette.fill(0);
     vram.fill(0);
     oam.fill(0);
-    sram.fill(0xFF);
+    sram.fill(0, sram.size(), 0xFF);
+    vramDirty.markAll();
+    oamDirty.markAll();
+    paletteDirty.markAll();
 }
 
 bool MMU::loadROM(const std::string& path) {
@@ -37,7 +51,88 @@ bool MMU::loadROM(const std::string& path) {
     return true;
 }
 
+bool MMU::loadSaveFile(const std::string& path) {
+    switch (saveType) {
+        case SaveType::SRAM:
+            return sram.map(path, sram.size());
+        case SaveType::Flash64K:
+        case SaveType::Flash128K:
+            return flash.mapSaveFile(path);
+        case SaveType::EEPROM:
+            return eeprom.mapSaveFile(path);
+        case SaveType::None:
+            break;
+    }
+    return false;
+}
+
+void MMU::writeSRAM(uint32_t address, uint8_t value) {
+    uint32_t offset = address & 0x7FFF;
+    sram[offset] = value;
+    sram.markDirty(offset);
+}
+
 uint8_t MMU::read8(uint32_t address) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Read)) {
+        uint8_t value = readDirect8(address);
+        reportAccess(address, value, 1, false);
+        return value;
+    }
+#endif
+    return readDirect8(address);
+}
+
+uint16_t MMU::read16(uint32_t address) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Read)) {
+        uint16_t value = readDirect16(address);
+        reportAccess(address, value, 2, false);
+        return value;
+    }
+#endif
+    return readDirect16(address);
+}
+
+uint32_t MMU::read32(uint32_t address) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Read)) {
+        uint32_t value = readDirect32(address);
+        reportAccess(address, value, 4, false);
+        return value;
+    }
+#endif
+    return readDirect32(address);
+}
+
+void MMU::write8(uint32_t address, uint8_t value) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Write)) {
+        reportAccess(address, value, 1, true);
+    }
+#endif
+    writeDirect8(address, value);
+}
+
+void MMU::write16(uint32_t address, uint16_t value) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Write)) {
+        reportAccess(address, value, 2, true);
+    }
+#endif
+    writeDirect16(address, value);
+}
+
+void MMU::write32(uint32_t address, uint32_t value) {
+#ifdef GBA_WATCHPOINTS
+    if (isWatched(address, WatchType::Write)) {
+        reportAccess(address, value, 4, true);
+    }
+#endif
+    writeDirect32(address, value);
+}
+
+uint8_t MMU::readDirect8(uint32_t address) {
     uint32_t region = (address >> 24) & 0xFF;
 
     switch (region) {
@@ -54,17 +149,11 @@ uint8_t MMU::read8(uint32_t address) {
         case 0x03:
             return iwram[address & 0x7FFF];
         case 0x04: {
-            uint32_t reg = (address & 0x3FF) >> 1;
-            
-            if (reg == 0x130 / 2) {
-                if (address & 1) return (keyInput >> 8) & 0xFF;
-                return keyInput & 0xFF;
-            }
-
+            uint16_t value = readIORegister((address & 0x3FF) >> 1);
             if (address & 1) {
-                return (io[reg] >> 8) & 0xFF;
+                return (value >> 8) & 0xFF;
             }
-            return io[reg] & 0xFF;
+            return value & 0xFF;
         }
         case 0x05:
             return palette[address & 0x3FF];
@@ -82,6 +171,9 @@ uint8_t MMU::read8(uint32_t address) {
         case 0x0B:
         case 0x0C:
         case 0x0D:
+            if (isEEPROMAccess(address)) {
+                return eeprom.read() & 0xFF;
+            }
             address &= 0x01FFFFFF;
             if (address < rom.size()) {
                 return rom[address];
@@ -92,13 +184,13 @@ uint8_t MMU::read8(uint32_t address) {
             if (saveType == SaveType::Flash64K || saveType == SaveType::Flash128K) {
                 return flash.read(address);
             }
-            return sram[address & 0xFFFF];
+            return sram[address & 0x7FFF];
     }
 
     return 0;
 }
 
-uint16_t MMU::read16(uint32_t address) {
+uint16_t MMU::readDirect16(uint32_t address) {
     uint32_t region = (address >> 24) & 0xFF;
     
     if (region == 0x0E || region == 0x0F) {
@@ -106,15 +198,24 @@ uint16_t MMU::read16(uint32_t address) {
             uint8_t val = flash.read(address);
             return val | (val << 8);
         }
-        uint8_t val = sram[address & 0xFFFF];
+        uint8_t val = sram[address & 0x7FFF];
         return val | (val << 8);
     }
     
     address &= ~1;
-    return read8(address) | (read8(address + 1) << 8);
+
+    if (region == 0x04) {
+        return readIORegister((address & 0x3FF) >> 1);
+    }
+
+    if (isEEPROMAccess(address)) {
+        return eeprom.read();
+    }
+
+    return readDirect8(address) | (readDirect8(address + 1) << 8);
 }
 
-uint32_t MMU::read32(uint32_t address) {
+uint32_t MMU::readDirect32(uint32_t address) {
     uint32_t region = (address >> 24) & 0xFF;
     
     if (region == 0x0E || region == 0x0F) {
@@ -122,16 +223,22 @@ uint32_t MMU::read32(uint32_t address) {
             uint8_t val = flash.read(address);
             return val | (val << 8) | (val << 16) | (val << 24);
         }
-        uint8_t val = sram[address & 0xFFFF];
+        uint8_t val = sram[address & 0x7FFF];
         return val | (val << 8) | (val << 16) | (val << 24);
     }
     
     address &= ~3;
-    return read8(address) | (read8(address + 1) << 8) |
-           (read8(address + 2) << 16) | (read8(address + 3) << 24);
+
+    // The cartridge bus is 16 bits wide, so EEPROM sees two halfword accesses.
+    if (isEEPROMAccess(address)) {
+        return readDirect16(address) | (readDirect16(address + 2) << 16);
+    }
+
+    return readDirect8(address) | (readDirect8(address + 1) << 8) |
+           (readDirect8(address + 2) << 16) | (readDirect8(address + 3) << 24);
 }
 
-void MMU::write8(uint32_t address, uint8_t value) {
+void MMU::writeDirect8(uint32_t address, uint8_t value) {
     uint32_t region = (address >> 24) & 0xFF;
 
     switch (region) {
@@ -143,17 +250,16 @@ void MMU::write8(uint32_t address, uint8_t value) {
             break;
         case 0x04: {
             uint32_t reg = (address & 0x3FF) >> 1;
-            if (address & 1) {
-                io[reg] = (io[reg] & 0x00FF) | (value << 8);
-            } else {
-                io[reg] = (io[reg] & 0xFF00) | value;
-            }
+            int shift = (address & 1) * 8;
+            uint16_t other = byteWriteBase(reg) & (0xFF00 >> shift);
+            writeIORegister(reg, other | (value << shift));
             break;
         }
         case 0x05: {
             uint32_t base = (address & 0x3FF) & ~1;
             palette[base] = value;
             palette[base + 1] = value;
+            paletteDirty.mark(base >> 5);
             break;
         }
         case 0x06: {
@@ -174,22 +280,28 @@ void MMU::write8(uint32_t address, uint8_t value) {
             uint32_t base = address & ~1;
             vram[base] = value;
             vram[base + 1] = value;
+            vramDirty.mark(base >> 5);
             break;
         }
         case 0x07:
             break;
+        case 0x0D:
+            if (isEEPROMAccess(address)) {
+                eeprom.write(value);
+            }
+            break;
         case 0x0E:
         case 0x0F:
             if (saveType == SaveType::Flash64K || saveType == SaveType::Flash128K) {
                 flash.write(address, value);
             } else {
-                sram[address & 0xFFFF] = value;
+                writeSRAM(address, value);
             }
             break;
     }
 }
 
-void MMU::write16(uint32_t address, uint16_t value) {
+void MMU::writeDirect16(uint32_t address, uint16_t value) {
     uint32_t region = (address >> 24) & 0xFF;
     
     if (region == 0x0E || region == 0x0F) {
@@ -197,23 +309,27 @@ void MMU::write16(uint32_t address, uint16_t value) {
         if (saveType == SaveType::Flash64K || saveType == SaveType::Flash128K) {
             flash.write(address, byteToWrite);
         } else {
-            sram[address & 0xFFFF] = byteToWrite;
+            writeSRAM(address, byteToWrite);
         }
         return;
     }
     
+    if (isEEPROMAccess(address)) {
+        eeprom.write(value);
+        return;
+    }
+
     address &= ~1;
     
     switch (region) {
-        case 0x04: {
-            uint32_t reg = (address & 0x3FF) >> 1;
-            io[reg] = value;
+        case 0x04:
+            writeIORegister((address & 0x3FF) >> 1, value);
             return;
-        }
         case 0x05: {
             uint32_t offset = address & 0x3FF;
             palette[offset] = value & 0xFF;
             palette[offset + 1] = (value >> 8) & 0xFF;
+            paletteDirty.mark(offset >> 5);
             return;
         }
         case 0x06: {
@@ -221,21 +337,23 @@ void MMU::write16(uint32_t address, uint16_t value) {
             if (addr >= 0x18000) addr -= 0x8000;
             vram[addr] = value & 0xFF;
             vram[addr + 1] = (value >> 8) & 0xFF;
+            vramDirty.mark(addr >> 5);
             return;
         }
         case 0x07: {
             uint32_t offset = address & 0x3FF;
             oam[offset] = value & 0xFF;
             oam[offset + 1] = (value >> 8) & 0xFF;
+            oamDirty.mark(offset >> 3);
             return;
         }
     }
 
-    write8(address, value & 0xFF);
-    write8(address + 1, (value >> 8) & 0xFF);
+    writeDirect8(address, value & 0xFF);
+    writeDirect8(address + 1, (value >> 8) & 0xFF);
 }
 
-void MMU::write32(uint32_t address, uint32_t value) {
+void MMU::writeDirect32(uint32_t address, uint32_t value) {
     uint32_t region = (address >> 24) & 0xFF;
     
     if (region == 0x0E || region == 0x0F) {
@@ -244,17 +362,23 @@ void MMU::write32(uint32_t address, uint32_t value) {
         if (saveType == SaveType::Flash64K || saveType == SaveType::Flash128K) {
             flash.write(address, byteToWrite);
         } else {
-            sram[address & 0xFFFF] = byteToWrite;
+            writeSRAM(address, byteToWrite);
         }
         return;
     }
     
     address &= ~3;
+
+    if (isEEPROMAccess(address)) {
+        writeDirect16(address, value & 0xFFFF);
+        writeDirect16(address + 2, (value >> 16) & 0xFFFF);
+        return;
+    }
     
     switch (region) {
         case 0x04: {
-            write16(address, value & 0xFFFF);
-            write16(address + 2, (value >> 16) & 0xFFFF);
+            writeDirect16(address, value & 0xFFFF);
+            writeDirect16(address + 2, (value >> 16) & 0xFFFF);
             return;
         }
         case 0x05: {
@@ -263,11 +387,12 @@ void MMU::write32(uint32_t address, uint32_t value) {
             palette[offset + 1] = (value >> 8) & 0xFF;
             palette[offset + 2] = (value >> 16) & 0xFF;
             palette[offset + 3] = (value >> 24) & 0xFF;
+            paletteDirty.mark(offset >> 5);
             return;
         }
         case 0x06: {
-            write16(address, value & 0xFFFF);
-            write16(address + 2, (value >> 16) & 0xFFFF);
+            writeDirect16(address, value & 0xFFFF);
+            writeDirect16(address + 2, (value >> 16) & 0xFFFF);
             return;
         }
         case 0x07: {
@@ -276,24 +401,119 @@ void MMU::write32(uint32_t address, uint32_t value) {
             oam[offset + 1] = (value >> 8) & 0xFF;
             oam[offset + 2] = (value >> 16) & 0xFF;
             oam[offset + 3] = (value >> 24) & 0xFF;
+            oamDirty.mark(offset >> 3);
             return;
         }
     }
 
-    write8(address, value & 0xFF);
-    write8(address + 1, (value >> 8) & 0xFF);
-    write8(address + 2, (value >> 16) & 0xFF);
-    write8(address + 3, (value >> 24) & 0xFF);
+    writeDirect8(address, value & 0xFF);
+    writeDirect8(address + 1, (value >> 8) & 0xFF);
+    writeDirect8(address + 2, (value >> 16) & 0xFF);
+    writeDirect8(address + 3, (value >> 24) & 0xFF);
 }
 
-uint16_t MMU::readIO(uint32_t address) {
-    uint32_t reg = (address & 0x3FF) >> 1;
-    return io[reg];
+void MMU::addWatchpoint(uint32_t address, uint32_t length, WatchType type) {
+    if (length == 0) return;
+    watchpoints.push_back({address, address + length - 1, type});
+    rebuildWatchPages();
+}
+
+void MMU::removeWatchpoint(uint32_t address) {
+    std::erase_if(watchpoints, [address](const Watchpoint& wp) { return wp.start == address; });
+    rebuildWatchPages();
+}
+
+void MMU::clearWatchpoints() {
+    watchpoints.clear();
+    rebuildWatchPages();
+}
+
+void MMU::setAccessTrace(bool enabled) {
+    accessTrace = enabled;
+    rebuildWatchPages();
+}
+
+void MMU::rebuildWatchPages() {
+    if (accessTrace) {
+        watchPages.fill(static_cast<uint8_t>(WatchType::ReadWrite));
+        return;
+    }
+
+    watchPages.fill(0);
+    for (const Watchpoint& wp : watchpoints) {
+        uint32_t first = (wp.start >> 16) & 0xFFF;
+        uint32_t last = (wp.end >> 16) & 0xFFF;
+        for (uint32_t page = first; ; page = (page + 1) & 0xFFF) {
+            watchPages[page] |= static_cast<uint8_t>(wp.type);
+            if (page == last) break;
+        }
+    }
+}
+
+void MMU::reportAccess(uint32_t address, uint32_t value, uint8_t size, bool write) {
+    if (!watchCallback) return;
+
+    MemoryAccess access{address, value, cpuPC, size, write};
+    if (accessTrace) {
+        watchCallback(access);
+        return;
+    }
+
+    uint8_t mask = static_cast<uint8_t>(write ? WatchType::Write : WatchType::Read);
+    uint32_t last = address + size - 1;
+    for (const Watchpoint& wp : watchpoints) {
+        if ((static_cast<uint8_t>(wp.type) & mask) && address <= wp.end && last >= wp.start) {
+            watchCallback(access);
+            return;
+        }
+    }
+}
+
+uint16_t MMU::readIO(uint32_t address) const {
+    return readIORegister((address & 0x3FF) >> 1);
 }
 
 void MMU::writeIO(uint32_t address, uint16_t value) {
-    uint32_t reg = (address & 0x3FF) >> 1;
+    writeIORegister((address & 0x3FF) >> 1, value);
+}
+
+void MMU::setIOReadHandler(uint32_t address, IOReadHandler handler) {
+    ioReadHandlers[(address & 0x3FF) >> 1] = std::move(handler);
+}
+
+void MMU::setIOWriteHandler(uint32_t address, IOWriteHandler handler, ByteMerge merge) {
+    ioWriteHandlers[(address & 0x3FF) >> 1] = std::move(handler);
+    ioByteMerge[(address & 0x3FF) >> 1] = merge;
+}
+
+uint16_t MMU::readIORegister(uint32_t reg) const {
+    const IOReadHandler& handler = ioReadHandlers[reg];
+    if (handler) {
+        return handler();
+    }
+    return io[reg];
+}
+
+uint16_t MMU::byteWriteBase(uint32_t reg) const {
+    switch (ioByteMerge[reg]) {
+        case ByteMerge::Latched:
+            return io[reg];
+        case ByteMerge::Clear:
+            return 0;
+        case ByteMerge::Readback:
+            break;
+    }
+    return readIORegister(reg);
+}
+
+// io[] always latches the last value written so byte writes can be merged;
+// the owning component is notified afterwards with the full halfword.
+void MMU::writeIORegister(uint32_t reg, uint16_t value) {
     io[reg] = value;
+    const IOWriteHandler& handler = ioWriteHandlers[reg];
+    if (handler) {
+        handler(value);
+    }
 }
 
 uint16_t MMU::getDisplayControl() const {
@@ -301,7 +521,7 @@ uint16_t MMU::getDisplayControl() const {
 }
 
 void MMU::detectSaveType() {
-    saveType = SaveType::SRAM;
+    saveType = SaveType::None;
     
     std::string romStr(rom.begin(), rom.end());
     
@@ -4,7 +4,12 @@
 #include <array>
 #include <vector>
 #include <string>
+#include <functional>
 #include "Flash.h"
+#include "EEPROM.h"
+#include "SaveFile.h"
+#include "Utils.h"
+#include "Watchpoint.h"
 
 class PPU;
 
@@ -16,6 +21,24 @@ enum class SaveType {
     EEPROM
 };
 
+using IOReadHandler = std::function<uint16_t()>;
+using IOWriteHandler = std::function<void(uint16_t)>;
+
+// Where a byte write to a register gets the byte it leaves alone.
+enum class ByteMerge : uint8_t {
+    Readback,   // the register's current read value
+    Latched,    // the last value written, for registers that read back something else
+    Clear       // zero, for write-1-to-clear registers
+};
+
+constexpr size_t VRAM_TILE_COUNT = 0x18000 / 32;
+constexpr size_t OAM_ENTRY_COUNT = 128;
+constexpr size_t PALETTE_BANK_COUNT = 32;
+
+using VRAMDirtyBitmap = Utils::DirtyBitmap<VRAM_TILE_COUNT>;
+using OAMDirtyBitmap = Utils::DirtyBitmap<OAM_ENTRY_COUNT>;
+using PaletteDirtyBitmap = Utils::DirtyBitmap<PALETTE_BANK_COUNT>;
+
 class MMU {
 public:
     MMU();
@@ -23,6 +46,7 @@ public:
     void connectPPU(PPU* ppu) { this->ppu = ppu; }
 
     bool loadROM(const std::string& path);
+    bool loadSaveFile(const std::string& path);
     void reset();
 
     uint8_t read8(uint32_t address);
@@ -33,27 +57,42 @@ public:
     void write16(uint32_t address, uint16_t value);
     void write32(uint32_t address, uint32_t value);
 
-    uint16_t readIO(uint32_t address);
+    void addWatchpoint(uint32_t address, uint32_t length, WatchType type);
+    void removeWatchpoint(uint32_t address);
+    void clearWatchpoints();
+    void setAccessTrace(bool enabled);
+    void setWatchCallback(WatchCallback callback) { watchCallback = std::move(callback); }
+
+    bool isEEPROMAccess(uint32_t address) const {
+        return saveType == SaveType::EEPROM && (address >> 24) == 0x0D &&
+               (rom.size() <= 0x1000000 || (address & 0x00FFFF00) == 0x00FFFF00);
+    }
+    EEPROM& getEEPROM() { return eeprom; }
+
+    uint16_t readIO(uint32_t address) const;
     void writeIO(uint32_t address, uint16_t value);
 
+    void setIOReadHandler(uint32_t address, IOReadHandler handler);
+    void setIOWriteHandler(uint32_t address, IOWriteHandler handler, ByteMerge merge = ByteMerge::Readback);
+
     uint8_t* getVRAM() { return vram.data(); }
     uint8_t* getPalette() { return palette.data(); }
     uint8_t* getOAM() { return oam.data(); }
 
-    uint16_t getDisplayControl() const;
-    uint16_t getDisplayStatus() const { return io[2]; }
-    uint16_t getVCount() const { return io[3]; }
-
-    void setVCount(uint16_t value) { io[3] = value; }
-    void setDisplayStatus(uint16_t value) { io[2] = value; }
+    const VRAMDirtyBitmap& getVRAMDirty() const { return vramDirty; }
+    const OAMDirtyBitmap& getOAMDirty() const { return oamDirty; }
+    const PaletteDirtyBitmap& getPaletteDirty() const { return paletteDirty; }
+    void clearVRAMDirty() { vramDirty.clear(); }
+    void clearOAMDirty() { oamDirty.clear(); }
+    void clearPaletteDirty() { paletteDirty.clear(); }
 
-    uint16_t getBGControl(int bg) const { return io[0x08 / 2 + bg]; }
-    uint16_t getBGXOffset(int bg) const { return io[0x10 / 2 + bg * 2]; }
-    uint16_t getBGYOffset(int bg) const { return io[0x12 / 2 + bg * 2]; }
+    uint16_t getDisplayControl() const;
+    uint16_t getDisplayStatus() const { return readIO(0x04000004); }
+    uint16_t getVCount() const { return readIO(0x04000006); }
 
     uint16_t getIE() const { return io[0x100]; }
-    uint16_t getIF() const { return io[0x101]; }
-    void setIF(uint16_t value) { io[0x101] = value; }
+    uint16_t getIF() const { return interruptFlags; }
+    void setIF(uint16_t value) { interruptFlags = value; }
     uint16_t getIME() const { return io[0x104]; }
     void setIME(uint16_t value) { io[0x104] = value; }
 
@@ -64,22 +103,54 @@ public:
     uint32_t getCpuPC() const { return cpuPC; }
 
 private:
+    uint8_t readDirect8(uint32_t address);
+    uint16_t readDirect16(uint32_t address);
+    uint32_t readDirect32(uint32_t address);
+    void writeDirect8(uint32_t address, uint8_t value);
+    void writeDirect16(uint32_t address, uint16_t value);
+    void writeDirect32(uint32_t address, uint32_t value);
+
+    bool isWatched(uint32_t address, WatchType type) const {
+        return watchPages[(address >> 16) & 0xFFF] & static_cast<uint8_t>(type);
+    }
+    void rebuildWatchPages();
+    void reportAccess(uint32_t address, uint32_t value, uint8_t size, bool write);
+
+    void writeSRAM(uint32_t address, uint8_t value);
     void detectSaveType();
+    void installDefaultIOHandlers();
+    uint16_t readIORegister(uint32_t reg) const;
+    uint16_t byteWriteBase(uint32_t reg) const;
+    void writeIORegister(uint32_t reg, uint16_t value);
+
     std::array<uint8_t, 0x4000> bios{};
     std::array<uint8_t, 0x40000> ewram{};
     std::array<uint8_t, 0x8000> iwram{};
     std::array<uint16_t, 0x200> io{};
+    std::array<IOReadHandler, 0x200> ioReadHandlers;
+    std::array<IOWriteHandler, 0x200> ioWriteHandlers;
+    std::array<ByteMerge, 0x200> ioByteMerge{};
     std::array<uint8_t, 0x400> palette{};
     std::array<uint8_t, 0x18000> vram{};
     std::array<uint8_t, 0x400> oam{};
+    VRAMDirtyBitmap vramDirty;
+    OAMDirtyBitmap oamDirty;
+    PaletteDirtyBitmap paletteDirty;
     std::vector<uint8_t> rom;
-    std::array<uint8_t, 0x10000> sram{};
+    SaveFile sram{0x8000};
     Flash flash;
+    EEPROM eeprom;
 
     PPU* ppu = nullptr;
 
+    std::vector<Watchpoint> watchpoints;
+    std::array<uint8_t, 0x1000> watchPages{};
+    bool accessTrace = false;
+    WatchCallback watchCallback;
+
     bool biosLoaded = false;
     uint16_t keyInput = 0x03FF;
+    uint16_t interruptFlags = 0;
     uint32_t cpuPC = 0x08000000;
     uint32_t lastBiosFetch = 0xE129F000;
     SaveType saveType = SaveType::SRAM;
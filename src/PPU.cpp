@@ -1,16 +1,166 @@
 #include "PPU.h"
 #include "MMU.h"
+#include "ColorCorrection.h"
+#include <algorithm>
 #include <iostream>
 
-PPU::PPU(MMU& mmu) : mmu(mmu) {
+namespace {
+
+int32_t signExtend28(uint32_t value) {
+    return static_cast<int32_t>(value << 4) >> 4;
+}
+}
+
+PPU::PPU(MMU& mmu) : mmu(mmu), renderer(outputColors, lineCache, lineDamage) {
+    buildOutputColors();
+    connectIO();
     reset();
 }
 
+PPU::~PPU() {
+    stopWorkers();
+}
+
+void PPU::connectIO() {
+    mmu.setIOWriteHandler(0x04000000, [this](uint16_t value) { writeDisplayControl(value); });
+
+    mmu.setIOReadHandler(0x04000004, [this]() { return dispstat; });
+    mmu.setIOWriteHandler(0x04000004, [this](uint16_t value) {
+        dispstat = (dispstat & 0x0007) | (value & 0xFFF8);
+        updateStatusFlags();
+    });
+    mmu.setIOReadHandler(0x04000006, [this]() { return static_cast<uint16_t>(scanline); });
+
+    for (int bg = 0; bg < 4; bg++) {
+        mmu.setIOWriteHandler(0x04000008 + bg * 2, [this, bg](uint16_t value) { writeBGControl(bg, value); });
+        mmu.setIOWriteHandler(0x04000010 + bg * 4, [this, bg](uint16_t value) { regs.bgHOffset[bg] = value & 0x1FF; });
+        mmu.setIOWriteHandler(0x04000012 + bg * 4, [this, bg](uint16_t value) { regs.bgVOffset[bg] = value & 0x1FF; });
+    }
+
+    for (int bg = 2; bg < 4; bg++) {
+        AffineParams& affine = regs.bgAffine[bg - 2];
+        uint32_t base = 0x04000020 + (bg - 2) * 0x10;
+        mmu.setIOWriteHandler(base + 0x0, [&affine](uint16_t value) { affine.pa = static_cast<int16_t>(value); });
+        mmu.setIOWriteHandler(base + 0x2, [&affine](uint16_t value) { affine.pb = static_cast<int16_t>(value); });
+        mmu.setIOWriteHandler(base + 0x4, [&affine](uint16_t value) { affine.pc = static_cast<int16_t>(value); });
+        mmu.setIOWriteHandler(base + 0x6, [&affine](uint16_t value) { affine.pd = static_cast<int16_t>(value); });
+        for (int reg = 0; reg < 4; reg++) {
+            mmu.setIOWriteHandler(base + 0x8 + reg * 2, [this, bg, reg](uint16_t value) { writeAffineReference(bg, reg, value); });
+        }
+    }
+
+    for (int win = 0; win < 2; win++) {
+        mmu.setIOWriteHandler(0x04000040 + win * 2, [this, win](uint16_t value) { regs.winH[win] = value; });
+        mmu.setIOWriteHandler(0x04000044 + win * 2, [this, win](uint16_t value) { regs.winV[win] = value; });
+    }
+    mmu.setIOWriteHandler(0x04000048, [this](uint16_t value) { regs.winIn = value; });
+    mmu.setIOWriteHandler(0x0400004A, [this](uint16_t value) { regs.winOut = value; });
+
+    mmu.setIOWriteHandler(0x0400004C, [this](uint16_t value) { regs.mosaic = value; });
+
+    mmu.setIOWriteHandler(0x04000050, [this](uint16_t value) { regs.blendControl = value & 0x3FFF; });
+    mmu.setIOWriteHandler(0x04000052, [this](uint16_t value) { regs.blendAlpha = value & 0x1F1F; });
+    mmu.setIOWriteHandler(0x04000054, [this](uint16_t value) { regs.blendBrightness = value & 0x1F; });
+}
+
 void PPU::reset() {
+    finishFrame();
+
     scanline = 0;
     dot = 0;
     frameReady = false;
     framebuffer.fill(0xFF000000);
+    invalidateDamage();
+    lineDamage.changed.fill(true);
+    collectDirtyLines();
+
+    dispstat = 0;
+    writeDisplayControl(0);
+    for (int bg = 0; bg < 4; bg++) {
+        writeBGControl(bg, 0);
+    }
+    regs.bgHOffset.fill(0);
+    regs.bgVOffset.fill(0);
+    regs.bgAffine.fill(AffineParams{});
+    regs.winH.fill(0);
+    regs.winV.fill(0);
+    regs.winIn = 0;
+    regs.winOut = 0;
+    regs.blendControl = 0;
+    regs.blendAlpha = 0;
+    regs.blendBrightness = 0;
+    regs.mosaic = 0;
+    mosaicSourceLine.fill(-1);
+    mosaicRenderLine.fill(-1);
+    lineSkipping = false;
+    updateStatusFlags();
+}
+
+void PPU::writeDisplayControl(uint16_t value) {
+    regs.videoMode = value & 0x7;
+    if (regs.videoMode > 5) {
+        regs.videoMode = 0;
+    }
+    regs.frameSelect = (value >> 4) & 1;
+    regs.hblankIntervalFree = (value >> 5) & 1;
+    regs.objMapping1D = (value >> 6) & 1;
+    regs.layerEnable = (value >> 8) & 0x1F;
+    regs.windowEnable = (value >> 13) & 7;
+}
+
+void PPU::writeBGControl(int bg, uint16_t value) {
+    BackgroundControl& control = regs.bgControl[bg];
+    control.priority = value & 3;
+    control.charBase = ((value >> 2) & 3) * 0x4000;
+    control.mosaic = (value >> 6) & 1;
+    control.color256 = (value >> 7) & 1;
+    control.screenBase = ((value >> 8) & 0x1F) * 0x800;
+    control.wraparound = (value >> 13) & 1;
+    control.screenSize = (value >> 14) & 3;
+}
+
+void PPU::writeAffineReference(int bg, int reg, uint16_t value) {
+    AffineParams& affine = regs.bgAffine[bg - 2];
+    uint32_t& ref = (reg < 2) ? affine.refX : affine.refY;
+    if (reg & 1) {
+        ref = (ref & 0x0000FFFF) | (static_cast<uint32_t>(value) << 16);
+    } else {
+        ref = (ref & 0xFFFF0000) | value;
+    }
+
+    if (reg < 2) {
+        affine.currentX = signExtend28(affine.refX);
+    } else {
+        affine.currentY = signExtend28(affine.refY);
+    }
+}
+
+void PPU::reloadAffineReferences() {
+    for (AffineParams& affine : regs.bgAffine) {
+        affine.currentX = signExtend28(affine.refX);
+        affine.currentY = signExtend28(affine.refY);
+    }
+}
+
+void PPU::advanceAffineReferences() {
+    for (AffineParams& affine : regs.bgAffine) {
+        affine.currentX += affine.pb;
+        affine.currentY += affine.pd;
+    }
+}
+
+void PPU::updateStatusFlags() {
+    constexpr int VDRAW_LINES = 160;
+
+    dispstat &= 0xFFF8;
+    if (scanline >= VDRAW_LINES) {
+        dispstat |= 1;
+    }
+
+    uint8_t vcountCompare = (dispstat >> 8) & 0xFF;
+    if (scanline == vcountCompare) {
+        dispstat |= 4;
+    }
 }
 
 void PPU::step(int cycles) {
@@ -27,334 +177,242 @@ void PPU::step(int cycles) {
         dot -= SCANLINE_CYCLES;
 
         if (scanline < VDRAW_LINES) {
-            renderScanline();
+            recordScanline();
+            advanceAffineReferences();
         }
 
         scanline++;
 
         if (scanline >= TOTAL_LINES) {
             scanline = 0;
+            finishFrame();
             frameReady = true;
         }
 
-        mmu.setVCount(scanline);
-    }
-
-    uint16_t dispstat = mmu.getDisplayStatus();
-    bool wasVBlank = (dispstat & 1);
-    dispstat &= 0xFFF8;
+        updateStatusFlags();
 
-    bool inVBlank = (scanline >= VDRAW_LINES && scanline < TOTAL_LINES);
-    if (inVBlank) {
-        dispstat |= 1;
-        
-        if (!wasVBlank) {
-            uint16_t if_ = mmu.getIF();
-            mmu.setIF(if_ | 0x01);
+        if (scanline == VDRAW_LINES) {
+            reloadAffineReferences();
+            mosaicSourceLine.fill(-1);
+            mmu.setIF(mmu.getIF() | 0x01);
         }
     }
-
-    uint8_t vcountCompare = (dispstat >> 8) & 0xFF;
-    if (scanline == vcountCompare) {
-        dispstat |= 4;
-    }
-
-    mmu.setDisplayStatus(dispstat);
 }
 
-void PPU::renderScanline() {
-    uint16_t dispcnt = mmu.getDisplayControl();
-    uint8_t mode = dispcnt & 0x7;
-    
-    if (mode > 5) {
-        mode = 0;
-    }
-
-    switch (mode) {
-        case 0:
-        case 1:
-        case 2:
-            renderMode0();
-            break;
-        case 3:
-            renderMode3();
-            break;
-        case 4:
-            renderMode4();
-            break;
-        case 5:
-            renderMode5();
-            break;
-    }
-
-    renderSprites();
-}
-
-void PPU::renderMode0() {
-    uint8_t* palette = mmu.getPalette();
-    uint16_t backdropColor = palette[0] | (palette[1] << 8);
-    uint32_t backdrop32 = rgb15to32(backdropColor);
-
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        framebuffer[scanline * SCREEN_WIDTH + x] = backdrop32;
-    }
-
-    uint16_t dispcnt = mmu.getDisplayControl();
+void PPU::recordScanline() {
+    if (scanline == 0) {
+        frameLog.frame++;
+        frameLog.target = frameTarget;
+        if (!frameLog.target.pixels) {
+            frameLog.target = {framebuffer.data(), static_cast<int>(SCREEN_WIDTH * sizeof(uint32_t)), PixelFormat::ARGB8888};
+        }
 
-    for (int priority = 3; priority >= 0; priority--) {
-        for (int bg = 3; bg >= 0; bg--) {
-            if (dispcnt & (1 << (8 + bg))) {
-                uint16_t bgcnt = mmu.getBGControl(bg);
-                if ((bgcnt & 3) == priority) {
-                    renderBackground(bg);
-                }
+        if (lineSkipping != requestedLineSkipping) {
+            lineSkipping = requestedLineSkipping;
+            if (lineSkipping) {
+                signatures.reset(mmu);
             }
         }
     }
-}
 
-void PPU::renderBackground(int bg) {
-    uint16_t bgcnt = mmu.getBGControl(bg);
-    uint16_t bghofs = mmu.getBGXOffset(bg);
-    uint16_t bgvofs = mmu.getBGYOffset(bg);
+    LineRecord& record = frameLog.lines[scanline];
+    record.state = regs;
 
-    int charBaseBlock = (bgcnt >> 2) & 3;
-    int screenBaseBlock = (bgcnt >> 8) & 0x1F;
-    bool color256 = (bgcnt >> 7) & 1;
-    int screenSize = (bgcnt >> 14) & 3;
+    uint8_t layers = regs.activeLayers();
+    for (int bg = 0; bg < 4; bg++) {
+        record.mosaicSource[bg] = -1;
+        if (!(layers & (1 << bg))) continue;
 
-    int priority = bgcnt & 3; 
-
-    uint32_t charBase = charBaseBlock * 0x4000;
-    uint32_t screenBase = screenBaseBlock * 0x800;
+        if (!regs.bgControl[bg].mosaic) {
+            mosaicSourceLine[bg] = -1;
+            continue;
+        }
 
-    int width = 256;
-    int height = 256;
+        int sourceLine = scanline - scanline % regs.bgMosaicV();
+        if (scanline != sourceLine && mosaicSourceLine[bg] == sourceLine) {
+            record.mosaicSource[bg] = static_cast<int16_t>(mosaicRenderLine[bg]);
+        } else {
+            mosaicSourceLine[bg] = sourceLine;
+            mosaicRenderLine[bg] = scanline;
+        }
+    }
 
-    if (screenSize == 1) width = 512;
-    if (screenSize == 2) height = 512;
-    if (screenSize == 3) { width = 512; height = 512; }
+    record.signature = lineSkipping ? lineSignature() : 0;
+    captureMemory(record);
 
-    uint8_t* vram = mmu.getVRAM();
-    uint8_t* palette = mmu.getPalette();
+    if (workers.empty()) {
+        renderer.renderLine(frameLog, scanline);
+        mmu.clearVRAMDirty();
+        mmu.clearOAMDirty();
+        mmu.clearPaletteDirty();
+        return;
+    }
 
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        int xx = (x + bghofs) % width;
-        int yy = (scanline + bgvofs) % height;
+    if ((scanline + 1) % STRIP_LINES == 0) {
+        {
+            std::lock_guard<std::mutex> lock(stripMutex);
+            stripsQueued++;
+        }
+        stripReady.notify_one();
+    }
+}
 
-        int screenBlockX = xx / 256;
-        int screenBlockY = yy / 256;
-        int screenBlockIndex = 0;
+uint64_t PPU::lineSignature() {
+    signatures.update(mmu);
+    uint64_t signature = signatures.compute(frameLog, scanline);
 
-        if (screenSize == 0) screenBlockIndex = 0; 
-        else if (screenSize == 1) screenBlockIndex = screenBlockX;
-        else if (screenSize == 2) screenBlockIndex = screenBlockY; 
-        else screenBlockIndex = screenBlockY * 2 + screenBlockX;
+    const LineRecord& record = frameLog.lines[scanline];
+    uint8_t layers = regs.activeLayers();
+    for (int bg = 0; bg < 4; bg++) {
+        if ((layers & (1 << bg)) && regs.bgControl[bg].mosaic && regs.bgMosaicV() > 1 && record.mosaicSource[bg] < 0) {
+            return 0;
+        }
+    }
+    return signature;
+}
 
-        int tileX = (xx % 256) / 8;
-        int tileY = (yy % 256) / 8;
-        int tileMapIndex = tileY * 32 + tileX;
+void PPU::captureMemory(LineRecord& record) {
+    bool vramChanged = mmu.getVRAMDirty().any();
+    bool oamChanged = mmu.getOAMDirty().any();
+    bool paletteChanged = mmu.getPaletteDirty().any();
+
+    if (workers.empty()) {
+        if (vramChanged) vramVersion++;
+        if (oamChanged) oamVersion++;
+        if (paletteChanged) paletteVersion++;
+        record.vram = {mmu.getVRAM(), &mmu.getVRAMDirty(), vramVersion};
+        record.vramJournal = nullptr;
+        record.oam = {mmu.getOAM(), &mmu.getOAMDirty(), oamVersion};
+        record.palette = {mmu.getPalette(), &mmu.getPaletteDirty(), paletteVersion};
+        return;
+    }
 
-        uint32_t mapAddr = screenBase + screenBlockIndex * 0x800 + tileMapIndex * 2;
-        uint16_t tileData = vram[mapAddr] | (vram[mapAddr + 1] << 8);
+    // Only the tiles written since the last line are copied; workers patch
+    // their own VRAM copies from the journal.
+    if (vramChanged) {
+        vramJournal.record(mmu.getVRAM(), mmu.getVRAMDirty(), ++vramVersion);
+        mmu.clearVRAMDirty();
+    }
+    if (oamChanged || oamSnapshots.empty()) {
+        currentOAM = oamSnapshots.capture(mmu.getOAM(), mmu.getOAMDirty(), ++oamVersion);
+        mmu.clearOAMDirty();
+    }
+    if (paletteChanged || paletteSnapshots.empty()) {
+        currentPalette = paletteSnapshots.capture(mmu.getPalette(), mmu.getPaletteDirty(), ++paletteVersion);
+        mmu.clearPaletteDirty();
+    }
+    record.vram = {nullptr, nullptr, vramVersion};
+    record.vramJournal = &vramJournal;
+    record.oam = currentOAM;
+    record.palette = currentPalette;
+}
 
-        int tileIndex = tileData & 0x3FF;
-        bool hFlip = (tileData >> 10) & 1;
-        bool vFlip = (tileData >> 11) & 1;
-        int paletteBank = (tileData >> 12) & 0xF;
+void PPU::finishFrame() {
+    if (!workers.empty()) {
+        std::unique_lock<std::mutex> lock(stripMutex);
+        stripDone.wait(lock, [this]() { return stripsFinished == stripsQueued; });
+        stripsQueued = 0;
+        stripsTaken = 0;
+        stripsFinished = 0;
+        lock.unlock();
+
+        // Keep the last frame's deltas so workers that rendered it catch up
+        // without copying all of VRAM.
+        vramJournal.trim(vramFrameStart);
+        vramFrameStart = vramVersion;
+        oamSnapshots.recycle();
+        paletteSnapshots.recycle();
+    }
+    collectDirtyLines();
 
-        int tilePixelX = xx % 8;
-        int tilePixelY = yy % 8;
+    int threads = std::clamp(requestedRenderThreads, 0, STRIP_COUNT);
+    if (threads != static_cast<int>(workers.size())) {
+        stopWorkers();
+        startWorkers(threads);
+    }
 
-        if (hFlip) tilePixelX = 7 - tilePixelX;
-        if (vFlip) tilePixelY = 7 - tilePixelY;
+    if (colorProfile != requestedColorProfile) {
+        colorProfile = requestedColorProfile;
+        buildOutputColors();
+        invalidateDamage();
+    }
+}
 
-        uint8_t param = 0;
-        uint32_t colorIndex = 0;
+void PPU::collectDirtyLines() {
+    dirtyLines.clear();
+    for (int line = 0; line < SCREEN_HEIGHT; line++) {
+        if (!lineDamage.changed[line]) continue;
 
-        if (!color256) {
-            uint32_t tileAddr = charBase + tileIndex * 32 + (tilePixelY * 4) + (tilePixelX / 2);
-            uint8_t byte = vram[tileAddr];
-            if (tilePixelX & 1) param = (byte >> 4) & 0xF;
-            else param = byte & 0xF;
-            
-            if (param != 0) {
-                colorIndex = paletteBank * 16 + param;
-            }
+        if (!dirtyLines.empty() && dirtyLines.back().first + dirtyLines.back().count == line) {
+            dirtyLines.back().count++;
         } else {
-            uint32_t tileAddr = charBase + tileIndex * 64 + (tilePixelY * 8) + tilePixelX;
-            param = vram[tileAddr];
-            if (param != 0) {
-                colorIndex = param;
-            }
-        }
-
-        if (param != 0) {
-            uint16_t color = palette[colorIndex * 2] | (palette[colorIndex * 2 + 1] << 8);
-            framebuffer[scanline * SCREEN_WIDTH + x] = rgb15to32(color);
+            dirtyLines.push_back({line, 1});
         }
     }
 }
 
-void PPU::renderMode3() {
-    uint8_t* vram = mmu.getVRAM();
+void PPU::startWorkers(int count) {
+    vramVersion++;
+    oamVersion++;
+    paletteVersion++;
+    vramJournal.reset(mmu.getVRAM(), vramVersion);
+    vramFrameStart = vramVersion;
 
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        uint32_t offset = (scanline * SCREEN_WIDTH + x) * 2;
-        uint16_t color = vram[offset] | (vram[offset + 1] << 8);
-        framebuffer[scanline * SCREEN_WIDTH + x] = rgb15to32(color);
+    stopping = false;
+    for (int i = 0; i < count; i++) {
+        workerRenderers.push_back(std::make_unique<Renderer>(outputColors, lineCache, lineDamage));
+    }
+    for (int i = 0; i < count; i++) {
+        workers.emplace_back(&PPU::workerLoop, this, i);
     }
 }
 
-void PPU::renderMode4() {
-    uint16_t dispcnt = mmu.getDisplayControl();
-    bool frame1 = (dispcnt >> 4) & 1;
-
-    uint8_t* vram = mmu.getVRAM();
-    uint8_t* palette = mmu.getPalette();
-
-    uint32_t baseAddr = frame1 ? 0xA000 : 0;
-
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        uint32_t offset = baseAddr + scanline * SCREEN_WIDTH + x;
-        uint8_t paletteIndex = vram[offset];
-
-        uint16_t color = palette[paletteIndex * 2] | (palette[paletteIndex * 2 + 1] << 8);
-        framebuffer[scanline * SCREEN_WIDTH + x] = rgb15to32(color);
+void PPU::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(stripMutex);
+        stopping = true;
     }
-}
+    stripReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    workerRenderers.clear();
 
-void PPU::renderMode5() {
-    uint16_t dispcnt = mmu.getDisplayControl();
-    bool frame1 = (dispcnt >> 4) & 1;
+    oamSnapshots.clear();
+    paletteSnapshots.clear();
+}
 
-    uint8_t* vram = mmu.getVRAM();
+void PPU::workerLoop(int index) {
+    Renderer& lineRenderer = *workerRenderers[index];
 
-    constexpr int MODE5_WIDTH = 160;
-    constexpr int MODE5_HEIGHT = 128;
+    std::unique_lock<std::mutex> lock(stripMutex);
+    while (true) {
+        stripReady.wait(lock, [this]() { return stopping || stripsTaken < stripsQueued; });
+        if (stopping) break;
 
-    uint32_t baseAddr = frame1 ? 0xA000 : 0;
+        int strip = stripsTaken++;
+        lock.unlock();
 
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        if (scanline < MODE5_HEIGHT && x < MODE5_WIDTH) {
-            uint32_t offset = baseAddr + (scanline * MODE5_WIDTH + x) * 2;
-            uint16_t color = vram[offset] | (vram[offset + 1] << 8);
-            framebuffer[scanline * SCREEN_WIDTH + x] = rgb15to32(color);
-        } else {
-            framebuffer[scanline * SCREEN_WIDTH + x] = 0xFF000000;
+        for (int line = strip * STRIP_LINES; line < (strip + 1) * STRIP_LINES; line++) {
+            lineRenderer.renderLine(frameLog, line);
         }
+
+        lock.lock();
+        stripsFinished++;
+        stripDone.notify_one();
     }
 }
 
-void PPU::renderSprites() {
-    uint16_t dispcnt = mmu.getDisplayControl();
-    if (!(dispcnt & 0x1000)) return;
-
-    bool mapping1D = (dispcnt >> 6) & 1;
-    uint8_t* vram = mmu.getVRAM();
-    uint8_t* oam = mmu.getOAM();
-    uint8_t* palette = mmu.getPalette();
-
-    const int widths[3][4] = {
-        {8, 16, 32, 64},
-        {16, 32, 32, 64},
-        {8, 8, 16, 32}
-    };
-    const int heights[3][4] = {
-        {8, 16, 32, 64},
-        {8, 8, 16, 32},
-        {16, 32, 32, 64}
-    };
-
-    for (int i = 0; i < 128; i++) {
-        uint16_t attr0 = oam[i * 8] | (oam[i * 8 + 1] << 8);
-        uint16_t attr1 = oam[i * 8 + 2] | (oam[i * 8 + 3] << 8);
-        uint16_t attr2 = oam[i * 8 + 4] | (oam[i * 8 + 5] << 8);
-
-        int y = attr0 & 0xFF;
-        int mode = (attr0 >> 8) & 3; 
-        if (mode == 2) continue;
-        
-        bool isAffine = (attr0 >> 8) & 1;
-        if (isAffine) continue;
-
-        int shape = (attr0 >> 14) & 3;
-        int size = (attr1 >> 14) & 3;
-
-        int width = widths[shape][size];
-        int height = heights[shape][size];
-
-        if (y >= 160) y -= 256;
-
-        if (scanline >= y && scanline < y + height) {
-            int x = attr1 & 0x1FF;
-            if (x >= 240) x -= 512;
-
-            bool hFlip = (attr1 >> 12) & 1;
-            bool vFlip = (attr1 >> 13) & 1;
-            bool color256 = (attr0 >> 13) & 1;
-
-            int tileIndex = attr2 & 0x3FF;
-            int priority = (attr2 >> 10) & 3;
-            int paletteBank = (attr2 >> 12) & 0xF;
-
-            int spriteY = scanline - y;
-            if (vFlip) spriteY = height - 1 - spriteY;
-
-            for (int spriteX = 0; spriteX < width; spriteX++) {
-                int screenX = x + spriteX;
-                if (screenX < 0 || screenX >= SCREEN_WIDTH) continue;
-
-                int texX = hFlip ? (width - 1 - spriteX) : spriteX;
-
-                uint32_t tileAddr = 0x10000;
-                
-                int tileRow = spriteY / 8;
-                int tileCol = texX / 8;
-                
-                int currentTileIndex = tileIndex;
-                if (mapping1D) {
-                    int tilesInSpriteRow = width / 8;
-                    currentTileIndex += tileRow * tilesInSpriteRow + tileCol;
-                     if (color256) currentTileIndex *= 2;
-                } else {
-                    int startX = tileIndex % 32;
-                    int startY = tileIndex / 32;
-                    int currentX = (startX + tileCol) % 32;
-                    int currentY = (startY + tileRow) % 32;
-                    
-                    currentTileIndex = currentY * 32 + currentX;
-                }
-
-                int pixelInTileX = texX % 8;
-                int pixelInTileY = spriteY % 8;
-
-                uint8_t colorIdx = 0;
-                if (!color256) {
-                     uint32_t addr = tileAddr + currentTileIndex * 32 + (pixelInTileY * 4) + (pixelInTileX / 2);
-                     uint8_t byte = vram[addr & 0x17FFF];
-                     if (pixelInTileX & 1) colorIdx = (byte >> 4) & 0xF;
-                     else colorIdx = byte & 0xF;
-                } else {
-                     uint32_t addr = tileAddr + currentTileIndex * 64 + (pixelInTileY * 8) + pixelInTileX;
-                     colorIdx = vram[addr & 0x17FFF];
-                }
-
-                if (colorIdx != 0) {
-                     int finalColorIdx = colorIdx;
-                     if (!color256) finalColorIdx += paletteBank * 16;
-                     
-                     uint16_t color = palette[0x200 + finalColorIdx * 2] | (palette[0x200 + finalColorIdx * 2 + 1] << 8);
-                     framebuffer[scanline * SCREEN_WIDTH + screenX] = rgb15to32(color);
-                }
-            }
-        }
+void PPU::buildOutputColors() {
+    for (uint32_t color = 0; color < outputColors.argb8888.size(); color++) {
+        outputColors.argb8888[color] = ColorCorrection::toARGB(color, colorProfile);
+        outputColors.rgb565[color] = ColorCorrection::toRGB565(color, colorProfile);
     }
 }
 
-uint32_t PPU::rgb15to32(uint16_t color) {
-    uint8_t r = (color & 0x1F) << 3;
-    uint8_t g = ((color >> 5) & 0x1F) << 3;
-    uint8_t b = ((color >> 10) & 0x1F) << 3;
-    return 0xFF000000 | (r << 16) | (g << 8) | b;
+void PPU::invalidateDamage() {
+    for (LineBuffer& line : lineDamage.previous) {
+        line.fill(0xFFFF);
+    }
 }
@@ -1,16 +1,65 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <array>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iterator>
+#include "Renderer.h"
+#include "LineSignatures.h"
+#include "VRAMJournal.h"
 
 class MMU;
 
-constexpr int SCREEN_WIDTH = 240;
-constexpr int SCREEN_HEIGHT = 160;
+template <size_t Size, typename Bitmap>
+class SnapshotPool {
+public:
+    MemoryRef<Bitmap> capture(const uint8_t* live, const Bitmap& dirty, uint64_t version) {
+        std::unique_ptr<Snapshot> snapshot;
+        if (spare.empty()) {
+            snapshot = std::make_unique<Snapshot>();
+        } else {
+            snapshot = std::move(spare.back());
+            spare.pop_back();
+        }
+        std::memcpy(snapshot->data.data(), live, Size);
+        snapshot->dirty = dirty;
+        inUse.push_back(std::move(snapshot));
+        return {inUse.back()->data.data(), &inUse.back()->dirty, version};
+    }
+
+    bool empty() const { return inUse.empty(); }
+
+    // Keeps only the newest snapshot in use.
+    void recycle() {
+        if (inUse.size() <= 1) return;
+        std::move(inUse.begin(), inUse.end() - 1, std::back_inserter(spare));
+        inUse.erase(inUse.begin(), inUse.end() - 1);
+    }
+
+    void clear() {
+        inUse.clear();
+        spare.clear();
+    }
+
+private:
+    struct Snapshot {
+        std::array<uint8_t, Size> data;
+        Bitmap dirty;
+    };
+
+    std::vector<std::unique_ptr<Snapshot>> inUse;
+    std::vector<std::unique_ptr<Snapshot>> spare;
+};
 
 class PPU {
 public:
     PPU(MMU& mmu);
+    ~PPU();
 
     void reset();
     void step(int cycles);
@@ -19,17 +68,43 @@ public:
     void clearFrameReady() { frameReady = false; }
 
     const uint32_t* getFramebuffer() const { return framebuffer.data(); }
+    void setFrameTarget(const FrameTarget& target) { frameTarget = target; }
+    const FrameTarget& getFrameOutput() const { return frameLog.target; }
+
+    void setRenderThreads(int count) { requestedRenderThreads = count; }
+    int getRenderThreads() const { return static_cast<int>(workers.size()); }
+
+    void setLineSkipping(bool enabled) { requestedLineSkipping = enabled; }
+    void setColorProfile(ColorProfile profile) { requestedColorProfile = profile; }
+    LineSkipStats getLineSkipStats() const { return {lineCache.hits.load(), lineCache.misses.load()}; }
+
+    // Lines of the last completed frame that differ from the frame before it.
+    const std::vector<LineRange>& getDirtyLines() const { return dirtyLines; }
 
 private:
-    void renderScanline();
-    void renderMode0();
-    void renderMode3();
-    void renderMode4();
-    void renderMode5();
-    void renderSprites();
-    void renderBackground(int bg);
+    void connectIO();
+    void writeDisplayControl(uint16_t value);
+    void writeBGControl(int bg, uint16_t value);
+    void writeAffineReference(int bg, int reg, uint16_t value);
+    void reloadAffineReferences();
+    void advanceAffineReferences();
+    void updateStatusFlags();
 
-    uint32_t rgb15to32(uint16_t color);
+    void recordScanline();
+    void captureMemory(LineRecord& record);
+    uint64_t lineSignature();
+    void finishFrame();
+    void collectDirtyLines();
+
+    void startWorkers(int count);
+    void stopWorkers();
+    void workerLoop(int index);
+
+    void buildOutputColors();
+    void invalidateDamage();
+
+    static constexpr int STRIP_LINES = 40;
+    static constexpr int STRIP_COUNT = SCREEN_HEIGHT / STRIP_LINES;
 
     MMU& mmu;
 
@@ -38,5 +113,47 @@ private:
 
     bool frameReady = false;
 
+    uint16_t dispstat = 0;
+    RenderState regs;
+
+    std::array<int, 4> mosaicSourceLine{};
+    std::array<int, 4> mosaicRenderLine{};
+
+    uint64_t vramVersion = 1;
+    uint64_t oamVersion = 1;
+    uint64_t paletteVersion = 1;
+
+    ColorProfile colorProfile = ColorProfile::None;
+    ColorProfile requestedColorProfile = ColorProfile::None;
+    OutputTables outputColors;
+    FrameLog frameLog;
+    LineCache lineCache;
+    LineDamage lineDamage;
+    Renderer renderer;
+
+    bool lineSkipping = false;
+    bool requestedLineSkipping = false;
+    LineSignatures signatures;
+
+    int requestedRenderThreads = 0;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Renderer>> workerRenderers;
+    std::mutex stripMutex;
+    std::condition_variable stripReady;
+    std::condition_variable stripDone;
+    int stripsQueued = 0;
+    int stripsTaken = 0;
+    int stripsFinished = 0;
+    bool stopping = false;
+
+    VRAMJournal vramJournal;
+    uint64_t vramFrameStart = 0;
+    SnapshotPool<0x400, OAMDirtyBitmap> oamSnapshots;
+    SnapshotPool<0x400, PaletteDirtyBitmap> paletteSnapshots;
+    MemoryRef<OAMDirtyBitmap> currentOAM;
+    MemoryRef<PaletteDirtyBitmap> currentPalette;
+
+    FrameTarget frameTarget;
     std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> framebuffer{};
+    std::vector<LineRange> dirtyLines;
 };
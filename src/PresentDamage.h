@@ -0,0 +1,32 @@
+#pragma once
+
+#include <bitset>
+#include <vector>
+#include "FrameTarget.h"
+#include "Renderer.h"
+
+// Lines the presenter has to upload for the frame about to be published.
+// A published frame that was never picked up is replaced by the next one,
+// so its lines are carried over instead of being lost.
+class PresentDamage {
+public:
+    using Lines = std::bitset<SCREEN_HEIGHT>;
+
+    // previousPending: the last published frame has not been consumed yet.
+    Lines next(const std::vector<LineRange>& changed, bool previousPending) {
+        Lines lines;
+        for (const LineRange& range : changed) {
+            for (int line = range.first; line < range.first + range.count; line++) {
+                lines.set(line);
+            }
+        }
+        if (previousPending) {
+            lines |= unconsumed;
+        }
+        unconsumed = lines;
+        return lines;
+    }
+
+private:
+    Lines unconsumed = Lines().set();
+};
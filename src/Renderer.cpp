@@ -0,0 +1,704 @@
+#include "Renderer.h"
+#include "Compositor.h"
+#include "VRAMJournal.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t modeLayers[6] = {0x1F, 0x17, 0x1C, 0x14, 0x14, 0x14};
+
+bool insideWindow(uint16_t bounds, int position, int limit) {
+    int start = bounds >> 8;
+    int end = bounds & 0xFF;
+    if (start > end) {
+        return position >= start || position < end;
+    }
+    if (end > limit) {
+        end = limit;
+    }
+    return position >= start && position < end;
+}
+}
+
+void affineTexels(int32_t x, int32_t y, int32_t pa, int32_t pc, int sizeShift, bool wrap,
+                  int32_t* mapOffsets, int32_t* pixelOffsets) {
+#ifdef PPU_USE_SSE2
+    const int32_t size = 128 << sizeShift;
+    const __m128i stepX = _mm_set1_epi32(pa * 8);
+    const __m128i stepY = _mm_set1_epi32(pc * 8);
+    const __m128i limit = _mm_set1_epi32(size - 1);
+    const __m128i seven = _mm_set1_epi32(7);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rowShift = _mm_cvtsi32_si128(4 + sizeShift);
+
+    __m128i xLow = _mm_setr_epi32(x, x + pa, x + pa * 2, x + pa * 3);
+    __m128i xHigh = _mm_add_epi32(xLow, _mm_set1_epi32(pa * 4));
+    __m128i yLow = _mm_setr_epi32(y, y + pc, y + pc * 2, y + pc * 3);
+    __m128i yHigh = _mm_add_epi32(yLow, _mm_set1_epi32(pc * 4));
+
+    auto texels = [&](__m128i fx, __m128i fy, int32_t* map, int32_t* pixel) {
+        __m128i tx = _mm_srai_epi32(fx, 8);
+        __m128i ty = _mm_srai_epi32(fy, 8);
+        __m128i outside = zero;
+        if (wrap) {
+            tx = _mm_and_si128(tx, limit);
+            ty = _mm_and_si128(ty, limit);
+        } else {
+            outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(zero, tx), _mm_cmpgt_epi32(tx, limit)),
+                                   _mm_or_si128(_mm_cmpgt_epi32(zero, ty), _mm_cmpgt_epi32(ty, limit)));
+        }
+        __m128i tile = _mm_add_epi32(_mm_sll_epi32(_mm_srai_epi32(ty, 3), rowShift), _mm_srai_epi32(tx, 3));
+        __m128i offset = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(ty, seven), 3), _mm_and_si128(tx, seven));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(map), _mm_or_si128(tile, outside));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixel), offset);
+    };
+
+    for (int i = 0; i < SCREEN_WIDTH; i += 8) {
+        texels(xLow, yLow, mapOffsets + i, pixelOffsets + i);
+        texels(xHigh, yHigh, mapOffsets + i + 4, pixelOffsets + i + 4);
+        xLow = _mm_add_epi32(xLow, stepX);
+        xHigh = _mm_add_epi32(xHigh, stepX);
+        yLow = _mm_add_epi32(yLow, stepY);
+        yHigh = _mm_add_epi32(yHigh, stepY);
+    }
+#else
+    affineTexelsScalar(x, y, pa, pc, sizeShift, wrap, mapOffsets, pixelOffsets, 0, SCREEN_WIDTH);
+#endif
+}
+
+void affineTexelsScalar(int32_t x, int32_t y, int32_t pa, int32_t pc, int sizeShift, bool wrap,
+                        int32_t* mapOffsets, int32_t* pixelOffsets, int first, int last) {
+    const int32_t size = 128 << sizeShift;
+    for (int i = first; i < last; i++) {
+        int32_t tx = (x + pa * i) >> 8;
+        int32_t ty = (y + pc * i) >> 8;
+        if (wrap) {
+            tx &= size - 1;
+            ty &= size - 1;
+        } else if (tx < 0 || tx >= size || ty < 0 || ty >= size) {
+            mapOffsets[i] = -1;
+            pixelOffsets[i] = 0;
+            continue;
+        }
+        mapOffsets[i] = ((ty >> 3) << (4 + sizeShift)) + (tx >> 3);
+        pixelOffsets[i] = ((ty & 7) << 3) | (tx & 7);
+    }
+}
+
+uint8_t RenderState::activeLayers() const {
+    return layerEnable & modeLayers[videoMode];
+}
+
+Renderer::Renderer(const OutputTables& outputColors, LineCache& lineCache, LineDamage& lineDamage)
+    : outputColors(outputColors), bitmapKernels(BitmapKernels::select()), lineCache(lineCache), lineDamage(lineDamage) {
+    bgLineSource.fill(~0ull);
+}
+
+void Renderer::renderLine(const FrameLog& log, int line) {
+    const LineRecord& record = log.lines[line];
+    uint8_t layers = record.state.activeLayers();
+
+    CachedLine& cached = lineCache.lines[line];
+    if (record.signature) {
+        if (cached.signature == record.signature) {
+            scanline = line;
+            syncMemory(record);
+            trackDamage(cached.colors, line);
+            writeLine(cached.colors, log.target);
+            lineCache.hits.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        lineCache.misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for (int bg = 0; bg < 4; bg++) {
+        if (!(layers & (1 << bg)) || record.mosaicSource[bg] < 0) continue;
+
+        int source = record.mosaicSource[bg];
+        uint64_t key = log.frame * SCREEN_HEIGHT + source;
+        if (bgLineSource[bg] != key) {
+            state = &log.lines[source].state;
+            scanline = source;
+            syncMemory(log.lines[source]);
+            renderMosaicLayer(bg);
+            bgLineSource[bg] = key;
+        }
+    }
+
+    state = &record.state;
+    scanline = line;
+    syncMemory(record);
+
+    for (int bg = 0; bg < 4; bg++) {
+        if (!(layers & (1 << bg)) || record.mosaicSource[bg] >= 0) continue;
+
+        if (state->bgControl[bg].mosaic) {
+            renderMosaicLayer(bg);
+        } else {
+            renderLayer(bg);
+        }
+        bgLineSource[bg] = log.frame * SCREEN_HEIGHT + line;
+    }
+
+    if (layers & 0x10) {
+        renderSprites();
+    }
+
+    LineBuffer& colors = record.signature ? cached.colors : composedLine;
+    composeScanline(layers, colors);
+    cached.signature = record.signature;
+    trackDamage(colors, line);
+    writeLine(colors, log.target);
+}
+
+void Renderer::trackDamage(const LineBuffer& colors, int line) {
+    LineBuffer& previous = lineDamage.previous[line];
+    lineDamage.changed[line] = previous != colors;
+    if (lineDamage.changed[line]) {
+        previous = colors;
+    }
+}
+
+void Renderer::syncMemory(const LineRecord& record) {
+    if (record.vramJournal) {
+        if (record.vram.version != vramVersion) {
+            syncVRAMCopy(*record.vramJournal, record.vram.version);
+        }
+    } else if (record.vram.version != vramVersion) {
+        vram = record.vram.data;
+        tileCache.setSource(vram);
+        if (record.vram.version == vramVersion + 1) {
+            tileCache.invalidate(*record.vram.dirty);
+        } else {
+            tileCache.invalidateAll();
+        }
+        vramVersion = record.vram.version;
+    }
+
+    if (record.palette.version != paletteVersion) {
+        syncPalette(record.palette, record.palette.version != paletteVersion + 1);
+        paletteVersion = record.palette.version;
+    }
+
+    if (record.oam.version != oamVersion) {
+        oam = record.oam.data;
+        syncSprites(record.oam, record.oam.version != oamVersion + 1);
+        oamVersion = record.oam.version;
+    }
+}
+
+void Renderer::syncVRAMCopy(const VRAMJournal& journal, uint64_t version) {
+    vramCopy.resize(0x18000);
+    VRAMDirtyBitmap changed;
+    if (journal.update(vramCopy.data(), vramVersion, version, changed)) {
+        tileCache.invalidate(changed);
+    } else {
+        tileCache.invalidateAll();
+    }
+    vram = vramCopy.data();
+    tileCache.setSource(vram);
+}
+
+void Renderer::syncPalette(const MemoryRef<PaletteDirtyBitmap>& ref, bool all) {
+    const uint8_t* palette = ref.data;
+    for (size_t bank = 0; bank < PALETTE_BANK_COUNT; bank++) {
+        if (!all && !ref.dirty->test(bank)) continue;
+        for (size_t i = bank * 16; i < bank * 16 + 16; i++) {
+            paletteColors[i] = (palette[i * 2] | (palette[i * 2 + 1] << 8)) & 0x7FFF;
+        }
+    }
+}
+
+void Renderer::syncSprites(const MemoryRef<OAMDirtyBitmap>& ref, bool all) {
+    for (int i = 0; i < OBJ_COUNT; i++) {
+        if (all || ref.dirty->test(i)) {
+            decodeSprite(i);
+        }
+    }
+
+    spriteBucketSize.fill(0);
+    for (int i = 0; i < OBJ_COUNT; i++) {
+        if (!sprites.visible[i]) continue;
+
+        int boundsHeight = sprites.height[i] << (sprites.doubleSize[i] ? 1 : 0);
+        int top = std::max<int>(sprites.y[i], 0);
+        int bottom = std::min<int>(sprites.y[i] + boundsHeight, SCREEN_HEIGHT);
+        for (int line = top; line < bottom; line++) {
+            spriteBuckets[line][spriteBucketSize[line]++] = static_cast<uint8_t>(i);
+        }
+    }
+}
+
+void Renderer::rebuildWindowMasks() {
+    windowEnable = state->windowEnable;
+    winH = state->winH;
+    winIn = state->winIn;
+    winOut = state->winOut;
+    windowValid = true;
+
+    for (int active = 0; active < 4; active++) {
+        MaskBuffer& mask = windowMasks[active];
+        if (!windowEnable) {
+            mask.fill(WINDOW_ALL);
+            continue;
+        }
+
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            if ((active & 1) && insideWindow(winH[0], x, SCREEN_WIDTH)) {
+                mask[x] = winIn & WINDOW_ALL;
+            } else if ((active & 2) && insideWindow(winH[1], x, SCREEN_WIDTH)) {
+                mask[x] = (winIn >> 8) & WINDOW_ALL;
+            } else {
+                mask[x] = (winOut & WINDOW_ALL) | WINDOW_OUTSIDE;
+            }
+        }
+    }
+}
+
+const uint8_t* Renderer::windowLine(uint8_t layers) {
+    if (!windowValid || windowEnable != state->windowEnable || winH != state->winH ||
+        winIn != state->winIn || winOut != state->winOut) {
+        rebuildWindowMasks();
+    }
+
+    int active = 0;
+    if ((windowEnable & 1) && insideWindow(state->winV[0], scanline, SCREEN_HEIGHT)) active |= 1;
+    if ((windowEnable & 2) && insideWindow(state->winV[1], scanline, SCREEN_HEIGHT)) active |= 2;
+
+    const MaskBuffer& mask = windowMasks[active];
+    if (!(windowEnable & 4) || !(layers & 0x10)) {
+        return mask.data();
+    }
+
+    uint8_t objMask = (winOut >> 8) & WINDOW_ALL;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        objWindowMask[x] = ((mask[x] & WINDOW_OUTSIDE) && objWindow[x]) ? objMask : mask[x];
+    }
+    return objWindowMask.data();
+}
+
+void Renderer::renderLayer(int bg) {
+    switch (state->videoMode) {
+        case 0:
+            renderBackground(bg);
+            break;
+        case 1:
+            if (bg < 2) renderBackground(bg);
+            else renderAffineBackground(bg);
+            break;
+        case 2:
+            renderAffineBackground(bg);
+            break;
+        case 3:
+            renderMode3();
+            break;
+        case 4:
+            renderMode4();
+            break;
+        case 5:
+            renderMode5();
+            break;
+    }
+}
+
+void Renderer::renderMosaicLayer(int bg) {
+    renderLayer(bg);
+
+    int size = state->bgMosaicH();
+    if (size == 1) return;
+
+    LineBuffer& line = bgLine[bg];
+    for (int x = 0; x < SCREEN_WIDTH; x += size) {
+        std::fill(line.begin() + x + 1, line.begin() + std::min(x + size, SCREEN_WIDTH), line[x]);
+    }
+}
+
+void Renderer::renderBackground(int bg) {
+    const BackgroundControl& control = state->bgControl[bg];
+
+    bool color256 = control.color256;
+    int screenSize = control.screenSize;
+
+    uint32_t charBase = control.charBase;
+    uint32_t screenBase = control.screenBase;
+
+    int width = (screenSize & 1) ? 512 : 256;
+    int height = (screenSize & 2) ? 512 : 256;
+
+    int yy = (scanline + state->bgVOffset[bg]) % height;
+    int screenBlockY = yy / 256;
+    int tileY = (yy % 256) / 8;
+    int tilePixelY = yy % 8;
+
+    int startX = state->bgHOffset[bg] % width;
+    int fineX = startX % 8;
+
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH + 16> span;
+
+    for (int column = 0; column * 8 < SCREEN_WIDTH + fineX; column++) {
+        int xx = ((startX & ~7) + column * 8) % width;
+        int screenBlockX = xx / 256;
+        int screenBlockIndex = 0;
+
+        if (screenSize == 1) screenBlockIndex = screenBlockX;
+        else if (screenSize == 2) screenBlockIndex = screenBlockY;
+        else if (screenSize == 3) screenBlockIndex = screenBlockY * 2 + screenBlockX;
+
+        int tileX = (xx % 256) / 8;
+        uint32_t mapAddr = screenBase + screenBlockIndex * 0x800 + (tileY * 32 + tileX) * 2;
+        uint16_t tileData = vram[mapAddr] | (vram[mapAddr + 1] << 8);
+
+        int tileIndex = tileData & 0x3FF;
+        bool hFlip = (tileData >> 10) & 1;
+        bool vFlip = (tileData >> 11) & 1;
+        int paletteBank = (tileData >> 12) & 0xF;
+        int row = vFlip ? 7 - tilePixelY : tilePixelY;
+
+        uint16_t* out = &span[column * 8];
+        const uint8_t* indices = nullptr;
+        const uint16_t* colors = paletteColors.data();
+
+        if (!color256) {
+            uint32_t tileAddr = charBase + tileIndex * 32;
+            if (tileAddr < 0x10000) {
+                indices = tileCache.row4bpp(tileAddr >> 5, row);
+                colors += paletteBank * 16;
+            }
+        } else {
+            uint32_t tileAddr = charBase + tileIndex * 64;
+            if (tileAddr < 0x10000) {
+                indices = vram + tileAddr + row * 8;
+            }
+        }
+
+        if (!indices) {
+            std::fill(out, out + 8, PIXEL_TRANSPARENT);
+            continue;
+        }
+
+        for (int px = 0; px < 8; px++) {
+            uint8_t index = indices[hFlip ? 7 - px : px];
+            out[px] = index ? colors[index] : PIXEL_TRANSPARENT;
+        }
+    }
+
+    std::copy(span.begin() + fineX, span.begin() + fineX + SCREEN_WIDTH, bgLine[bg].begin());
+}
+
+void Renderer::renderAffineBackground(int bg) {
+    const BackgroundControl& control = state->bgControl[bg];
+    const AffineParams& affine = state->bgAffine[bg - 2];
+
+    alignas(16) std::array<int32_t, SCREEN_WIDTH> mapOffsets;
+    alignas(16) std::array<int32_t, SCREEN_WIDTH> pixelOffsets;
+    affineTexels(affine.currentX, affine.currentY, affine.pa, affine.pc, control.screenSize, control.wraparound,
+                 mapOffsets.data(), pixelOffsets.data());
+
+    const uint8_t* map = vram + control.screenBase;
+    const uint8_t* tiles = vram + control.charBase;
+    LineBuffer& line = bgLine[bg];
+
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        if (mapOffsets[x] < 0) {
+            line[x] = PIXEL_TRANSPARENT;
+            continue;
+        }
+        uint8_t index = tiles[map[mapOffsets[x]] * 64 + pixelOffsets[x]];
+        line[x] = index ? paletteColors[index] : PIXEL_TRANSPARENT;
+    }
+}
+
+void Renderer::renderMode3() {
+    bitmapKernels.directColors(vram + scanline * SCREEN_WIDTH * 2, bgLine[2].data(), SCREEN_WIDTH);
+}
+
+void Renderer::renderMode4() {
+    uint32_t baseAddr = state->frameSelect ? 0xA000 : 0;
+    bitmapKernels.paletteIndices(vram + baseAddr + scanline * SCREEN_WIDTH, paletteColors.data(), bgLine[2].data(),
+                                 SCREEN_WIDTH);
+}
+
+void Renderer::renderMode5() {
+    LineBuffer& line = bgLine[2];
+
+    constexpr int MODE5_WIDTH = 160;
+    constexpr int MODE5_HEIGHT = 128;
+
+    if (scanline >= MODE5_HEIGHT) {
+        line.fill(PIXEL_TRANSPARENT);
+        return;
+    }
+
+    uint32_t baseAddr = state->frameSelect ? 0xA000 : 0;
+    bitmapKernels.directColors(vram + baseAddr + scanline * MODE5_WIDTH * 2, line.data(), MODE5_WIDTH);
+    std::fill(line.begin() + MODE5_WIDTH, line.end(), PIXEL_TRANSPARENT);
+}
+
+void Renderer::decodeSprite(int index) {
+    const uint8_t* entry = oam + index * 8;
+    uint16_t attr0 = entry[0] | (entry[1] << 8);
+    uint16_t attr1 = entry[2] | (entry[3] << 8);
+    uint16_t attr2 = entry[4] | (entry[5] << 8);
+    uint16_t attr3 = entry[6] | (entry[7] << 8);
+
+    sprites.affineParams[index / 4][index % 4] = static_cast<int16_t>(attr3);
+
+    bool affine = (attr0 >> 8) & 1;
+    int shape = (attr0 >> 14) & 3;
+    int size = (attr1 >> 14) & 3;
+
+    sprites.affine[index] = affine;
+    sprites.doubleSize[index] = affine && ((attr0 >> 9) & 1);
+    sprites.affineGroup[index] = (attr1 >> 9) & 0x1F;
+    sprites.visible[index] = (affine || !((attr0 >> 9) & 1)) && shape != 3;
+    sprites.mode[index] = static_cast<ObjMode>((attr0 >> 10) & 3);
+    sprites.mosaic[index] = (attr0 >> 12) & 1;
+    sprites.color256[index] = (attr0 >> 13) & 1;
+    sprites.hFlip[index] = !affine && ((attr1 >> 12) & 1);
+    sprites.vFlip[index] = !affine && ((attr1 >> 13) & 1);
+    sprites.tile[index] = attr2 & 0x3FF;
+    sprites.priority[index] = (attr2 >> 10) & 3;
+    sprites.paletteBank[index] = (attr2 >> 12) & 0xF;
+
+    if (shape == 3) {
+        sprites.width[index] = 0;
+        sprites.height[index] = 0;
+        return;
+    }
+    sprites.width[index] = OBJ_WIDTHS[shape][size];
+    sprites.height[index] = OBJ_HEIGHTS[shape][size];
+
+    int x = attr1 & 0x1FF;
+    int y = attr0 & 0xFF;
+    sprites.x[index] = static_cast<int16_t>(x >= SCREEN_WIDTH ? x - 512 : x);
+    sprites.y[index] = static_cast<int16_t>(y >= SCREEN_HEIGHT ? y - 256 : y);
+}
+
+void Renderer::renderSprites() {
+    objLine.fill(PIXEL_TRANSPARENT);
+    objPriority.fill(4);
+    objWindow.fill(0);
+    objSemiTransparent.fill(0);
+    objSemiTransparentOnLine = false;
+
+    constexpr int OBJ_CYCLES = 1210;
+    constexpr int OBJ_CYCLES_HBLANK_FREE = 954;
+
+    int budget = state->hblankIntervalFree ? OBJ_CYCLES_HBLANK_FREE : OBJ_CYCLES;
+
+    for (int n = 0; n < spriteBucketSize[scanline]; n++) {
+        int i = spriteBuckets[scanline][n];
+        int width = sprites.width[i];
+        int height = sprites.height[i];
+
+        if (sprites.affine[i]) {
+            budget -= 10 + 2 * (width << (sprites.doubleSize[i] ? 1 : 0));
+        } else {
+            budget -= width;
+        }
+        if (budget < 0) break;
+
+        bool color256 = sprites.color256[i];
+        int tileIndex = sprites.tile[i];
+        if (state->videoMode >= 3 && tileIndex < 512) continue;
+
+        if (sprites.affine[i]) {
+            renderAffineSprite(i);
+            continue;
+        }
+
+        int x = sprites.x[i];
+        bool hFlip = sprites.hFlip[i];
+        int priority = sprites.priority[i];
+        bool window = sprites.mode[i] == ObjMode::Window;
+        uint8_t semiTransparent = sprites.mode[i] == ObjMode::SemiTransparent;
+        objSemiTransparentOnLine |= semiTransparent;
+
+        bool mosaic = sprites.mosaic[i];
+        int line = mosaic ? std::max(mosaicLine(state->objMosaicV()), static_cast<int>(sprites.y[i])) : scanline;
+        int spriteY = line - sprites.y[i];
+        if (sprites.vFlip[i]) spriteY = height - 1 - spriteY;
+
+        int tileRow = spriteY / 8;
+        int pixelInTileY = spriteY % 8;
+
+        int rowTile;
+        if (state->objMapping1D) {
+            rowTile = tileIndex + tileRow * (width / 8) * (color256 ? 2 : 1);
+        } else {
+            rowTile = (color256 ? tileIndex & ~1 : tileIndex) + tileRow * 32;
+        }
+
+        int firstX = std::max(x, 0);
+        int lastX = std::min(x + width, SCREEN_WIDTH);
+
+        alignas(16) std::array<uint8_t, 64> texels;
+        for (int tileCol = 0; tileCol < width / 8; tileCol++) {
+            int localX = hFlip ? width - 8 - tileCol * 8 : tileCol * 8;
+            if (x + localX + 8 <= firstX || x + localX >= lastX) continue;
+
+            const uint8_t* row;
+            if (!color256) {
+                uint32_t tile = (rowTile + tileCol) & 0x3FF;
+                row = tileCache.row4bpp((0x10000 >> 5) + tile, pixelInTileY);
+            } else {
+                uint32_t tile = (rowTile + tileCol * 2) & 0x3FF;
+                row = vram + 0x10000 + ((tile * 32 + pixelInTileY * 8) & 0x7FFF);
+            }
+
+            for (int pixelInTileX = 0; pixelInTileX < 8; pixelInTileX++) {
+                texels[localX + (hFlip ? 7 - pixelInTileX : pixelInTileX)] = row[pixelInTileX];
+            }
+        }
+
+        const uint16_t* colors = paletteColors.data() + 256 + (color256 ? 0 : sprites.paletteBank[i] * 16);
+        int mosaicH = state->objMosaicH();
+
+        for (int screenX = firstX; screenX < lastX; screenX++) {
+            int sampleX = mosaic ? std::max(screenX - screenX % mosaicH, x) : screenX;
+            uint8_t colorIdx = texels[sampleX - x];
+            if (colorIdx == 0) continue;
+
+            if (window) {
+                objWindow[screenX] = 1;
+            } else if (priority < objPriority[screenX]) {
+                objLine[screenX] = colors[colorIdx];
+                objPriority[screenX] = priority;
+                objSemiTransparent[screenX] = semiTransparent;
+            }
+        }
+    }
+}
+
+void Renderer::renderAffineSprite(int index) {
+    int width = sprites.width[index];
+    int height = sprites.height[index];
+    int boundsWidth = width << (sprites.doubleSize[index] ? 1 : 0);
+    int boundsHeight = height << (sprites.doubleSize[index] ? 1 : 0);
+
+    const std::array<int16_t, 4>& params = sprites.affineParams[sprites.affineGroup[index]];
+    int32_t pa = params[0];
+    int32_t pb = params[1];
+    int32_t pc = params[2];
+    int32_t pd = params[3];
+
+    int x = sprites.x[index];
+    int firstX = std::max(x, 0);
+    int lastX = std::min(x + boundsWidth, SCREEN_WIDTH);
+    if (firstX >= lastX) return;
+
+    bool mosaic = sprites.mosaic[index];
+    int mosaicH = state->objMosaicH();
+    int line = mosaic ? std::max(mosaicLine(state->objMosaicV()), static_cast<int>(sprites.y[index])) : scanline;
+
+    int iy = line - sprites.y[index] - boundsHeight / 2;
+    int ix = firstX - x - boundsWidth / 2;
+    int32_t startX = pa * ix + pb * iy + (width << 7);
+    int32_t startY = pc * ix + pd * iy + (height << 7);
+    int32_t texX = startX;
+    int32_t texY = startY;
+
+    bool color256 = sprites.color256[index];
+    int tileIndex = sprites.tile[index];
+    int priority = sprites.priority[index];
+    bool window = sprites.mode[index] == ObjMode::Window;
+    uint8_t semiTransparent = sprites.mode[index] == ObjMode::SemiTransparent;
+    objSemiTransparentOnLine |= semiTransparent;
+    int tileStep = color256 ? 2 : 1;
+    int rowStride = state->objMapping1D ? (width / 8) * tileStep : 32;
+    if (color256 && !state->objMapping1D) tileIndex &= ~1;
+
+    const uint16_t* colors = paletteColors.data() + 256 + (color256 ? 0 : sprites.paletteBank[index] * 16);
+
+    for (int screenX = firstX; screenX < lastX; screenX++, texX += pa, texY += pc) {
+        if (mosaic) {
+            int offset = std::max(screenX - screenX % mosaicH, x) - firstX;
+            texX = startX + pa * offset;
+            texY = startY + pc * offset;
+        }
+
+        uint32_t tx = static_cast<uint32_t>(texX >> 8);
+        uint32_t ty = static_cast<uint32_t>(texY >> 8);
+        if (tx >= static_cast<uint32_t>(width) || ty >= static_cast<uint32_t>(height)) continue;
+        if (!window && priority >= objPriority[screenX]) continue;
+
+        uint32_t tile = (tileIndex + (ty / 8) * rowStride + (tx / 8) * tileStep) & 0x3FF;
+        uint8_t colorIdx;
+        if (!color256) {
+            colorIdx = tileCache.row4bpp((0x10000 >> 5) + tile, ty % 8)[tx % 8];
+        } else {
+            colorIdx = vram[0x10000 + ((tile * 32 + (ty % 8) * 8 + tx % 8) & 0x7FFF)];
+        }
+
+        if (colorIdx == 0) continue;
+
+        if (window) {
+            objWindow[screenX] = 1;
+        } else {
+            objLine[screenX] = colors[colorIdx];
+            objPriority[screenX] = priority;
+            objSemiTransparent[screenX] = semiTransparent;
+        }
+    }
+}
+
+void Renderer::composeScanline(uint8_t layers, LineBuffer& colors) {
+    alignas(16) Compositor::Line line;
+    const uint8_t* window = windowLine(layers);
+
+    auto targets = [this](int layer) {
+        uint16_t flags = 0;
+        if (state->blendControl & (1 << layer)) flags |= Compositor::TARGET_FIRST;
+        if (state->blendControl & (0x100 << layer)) flags |= Compositor::TARGET_SECOND;
+        return flags;
+    };
+
+    Compositor::fill(line, paletteColors[0], targets(5));
+
+    for (int priority = 3; priority >= 0; priority--) {
+        for (int bg = 3; bg >= 0; bg--) {
+            if ((layers & (1 << bg)) && state->bgControl[bg].priority == priority) {
+                Compositor::overlayLayer(line, bgLine[bg].data(), window, 1 << bg, targets(bg));
+            }
+        }
+        if (layers & 0x10) {
+            Compositor::overlayObjects(line, objLine.data(), objPriority.data(), priority, window,
+                                       objSemiTransparent.data(), targets(4));
+        }
+    }
+
+    Compositor::EffectParams effects;
+    effects.effect = static_cast<Compositor::Effect>((state->blendControl >> 6) & 3);
+    effects.eva = state->blendAlpha & 0x1F;
+    effects.evb = (state->blendAlpha >> 8) & 0x1F;
+    effects.evy = state->blendBrightness & 0x1F;
+    if (effects.effect != Compositor::Effect::None || objSemiTransparentOnLine) {
+        Compositor::applyEffects(line, window, effects);
+    }
+
+    colors = line.top;
+}
+
+void Renderer::writeLine(const LineBuffer& colors, const FrameTarget& target) {
+    uint8_t* row = static_cast<uint8_t*>(target.pixels) + scanline * target.pitch;
+    switch (target.format) {
+        case PixelFormat::ARGB8888: {
+            uint32_t* out = reinterpret_cast<uint32_t*>(row);
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                out[x] = outputColors.argb8888[colors[x]];
+            }
+            break;
+        }
+        case PixelFormat::RGB565: {
+            uint16_t* out = reinterpret_cast<uint16_t*>(row);
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                out[x] = outputColors.rgb565[colors[x]];
+            }
+            break;
+        }
+        case PixelFormat::BGR555:
+            std::memcpy(row, colors.data(), SCREEN_WIDTH * sizeof(uint16_t));
+            break;
+    }
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "TileCache.h"
+#include "BitmapKernels.h"
+#include "FrameTarget.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PPU_USE_SSE2
+#endif
+
+constexpr int SCREEN_WIDTH = 240;
+constexpr int SCREEN_HEIGHT = 160;
+
+constexpr uint16_t PIXEL_TRANSPARENT = 0x8000;
+
+using LineBuffer = std::array<uint16_t, SCREEN_WIDTH>;
+using MaskBuffer = std::array<uint8_t, SCREEN_WIDTH>;
+
+constexpr uint8_t WINDOW_ALL = 0x3F;
+constexpr uint8_t WINDOW_EFFECTS = 0x20;
+constexpr uint8_t WINDOW_OUTSIDE = 0x80;
+
+struct BackgroundControl {
+    int priority = 0;
+    uint32_t charBase = 0;
+    uint32_t screenBase = 0;
+    bool mosaic = false;
+    bool color256 = false;
+    bool wraparound = false;
+    int screenSize = 0;
+};
+
+struct AffineParams {
+    int16_t pa = 0x100;
+    int16_t pb = 0;
+    int16_t pc = 0;
+    int16_t pd = 0x100;
+    uint32_t refX = 0;
+    uint32_t refY = 0;
+    int32_t currentX = 0;
+    int32_t currentY = 0;
+};
+
+// Map entry and tile-pixel offsets for one line of an affine BG starting at (x, y)
+// in 24.8 fixed point; a mapOffsets entry is -1 where a non-wrapping BG is outside.
+void affineTexels(int32_t x, int32_t y, int32_t pa, int32_t pc, int sizeShift, bool wrap,
+                  int32_t* mapOffsets, int32_t* pixelOffsets);
+// Per-pixel version over [first, last); defines the result the vector path must reproduce.
+void affineTexelsScalar(int32_t x, int32_t y, int32_t pa, int32_t pc, int sizeShift, bool wrap,
+                        int32_t* mapOffsets, int32_t* pixelOffsets, int first, int last);
+
+enum class ObjMode : uint8_t {
+    Normal = 0,
+    SemiTransparent = 1,
+    Window = 2,
+    Prohibited = 3
+};
+
+constexpr int OBJ_COUNT = 128;
+
+constexpr uint8_t OBJ_WIDTHS[3][4] = {
+    {8, 16, 32, 64},
+    {16, 32, 32, 64},
+    {8, 8, 16, 32}
+};
+constexpr uint8_t OBJ_HEIGHTS[3][4] = {
+    {8, 16, 32, 64},
+    {8, 8, 16, 32},
+    {16, 32, 32, 64}
+};
+
+struct SpriteTable {
+    std::array<int16_t, OBJ_COUNT> x{};
+    std::array<int16_t, OBJ_COUNT> y{};
+    std::array<uint8_t, OBJ_COUNT> width{};
+    std::array<uint8_t, OBJ_COUNT> height{};
+    std::array<uint16_t, OBJ_COUNT> tile{};
+    std::array<uint8_t, OBJ_COUNT> priority{};
+    std::array<uint8_t, OBJ_COUNT> paletteBank{};
+    std::array<ObjMode, OBJ_COUNT> mode{};
+    std::array<bool, OBJ_COUNT> visible{};
+    std::array<bool, OBJ_COUNT> affine{};
+    std::array<bool, OBJ_COUNT> doubleSize{};
+    std::array<uint8_t, OBJ_COUNT> affineGroup{};
+    std::array<bool, OBJ_COUNT> hFlip{};
+    std::array<bool, OBJ_COUNT> vFlip{};
+    std::array<bool, OBJ_COUNT> color256{};
+    std::array<bool, OBJ_COUNT> mosaic{};
+    std::array<std::array<int16_t, 4>, OBJ_COUNT / 4> affineParams{};
+};
+
+struct RenderState {
+    int videoMode = 0;
+    bool frameSelect = false;
+    bool objMapping1D = false;
+    bool hblankIntervalFree = false;
+    uint8_t layerEnable = 0;
+    std::array<BackgroundControl, 4> bgControl{};
+    std::array<uint16_t, 4> bgHOffset{};
+    std::array<uint16_t, 4> bgVOffset{};
+    std::array<AffineParams, 2> bgAffine{};
+
+    uint8_t windowEnable = 0;
+    std::array<uint16_t, 2> winH{};
+    std::array<uint16_t, 2> winV{};
+    uint16_t winIn = 0;
+    uint16_t winOut = 0;
+
+    uint16_t blendControl = 0;
+    uint16_t blendAlpha = 0;
+    uint16_t blendBrightness = 0;
+
+    uint16_t mosaic = 0;
+
+    uint8_t activeLayers() const;
+
+    int bgMosaicH() const { return (mosaic & 0xF) + 1; }
+    int bgMosaicV() const { return ((mosaic >> 4) & 0xF) + 1; }
+    int objMosaicH() const { return ((mosaic >> 8) & 0xF) + 1; }
+    int objMosaicV() const { return ((mosaic >> 12) & 0xF) + 1; }
+};
+
+template <typename Bitmap>
+struct MemoryRef {
+    const uint8_t* data = nullptr;
+    const Bitmap* dirty = nullptr;
+    uint64_t version = 0;
+};
+
+class VRAMJournal;
+
+struct LineRecord {
+    RenderState state;
+    std::array<int16_t, 4> mosaicSource{};
+    uint64_t signature = 0;
+    MemoryRef<VRAMDirtyBitmap> vram;
+    // Set instead of vram.data when workers render; vram.version selects the journal version.
+    const VRAMJournal* vramJournal = nullptr;
+    MemoryRef<OAMDirtyBitmap> oam;
+    MemoryRef<PaletteDirtyBitmap> palette;
+};
+
+struct FrameLog {
+    uint64_t frame = 0;
+    FrameTarget target;
+    std::array<LineRecord, SCREEN_HEIGHT> lines;
+};
+
+struct OutputTables {
+    std::array<uint32_t, 0x8000> argb8888{};
+    std::array<uint16_t, 0x8000> rgb565{};
+};
+
+struct CachedLine {
+    uint64_t signature = 0;
+    alignas(16) LineBuffer colors{};
+};
+
+struct LineCache {
+    std::array<CachedLine, SCREEN_HEIGHT> lines;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
+
+// Last composed colors of every line, used to find the lines that changed
+// since the previous frame.
+struct LineDamage {
+    std::array<LineBuffer, SCREEN_HEIGHT> previous{};
+    std::array<bool, SCREEN_HEIGHT> changed{};
+};
+
+struct LineSkipStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+class Renderer {
+public:
+    Renderer(const OutputTables& outputColors, LineCache& lineCache, LineDamage& lineDamage);
+
+    void renderLine(const FrameLog& log, int line);
+
+private:
+    void syncMemory(const LineRecord& record);
+    void syncVRAMCopy(const VRAMJournal& journal, uint64_t version);
+    void syncPalette(const MemoryRef<PaletteDirtyBitmap>& ref, bool all);
+    void syncSprites(const MemoryRef<OAMDirtyBitmap>& ref, bool all);
+    void decodeSprite(int index);
+
+    void renderLayer(int bg);
+    void renderMosaicLayer(int bg);
+    void renderMode3();
+    void renderMode4();
+    void renderMode5();
+    void renderSprites();
+    void renderAffineSprite(int index);
+    void renderBackground(int bg);
+    void renderAffineBackground(int bg);
+    void rebuildWindowMasks();
+    const uint8_t* windowLine(uint8_t layers);
+    void composeScanline(uint8_t layers, LineBuffer& colors);
+    void trackDamage(const LineBuffer& colors, int line);
+    void writeLine(const LineBuffer& colors, const FrameTarget& target);
+
+    int mosaicLine(int size) const { return scanline - scanline % size; }
+
+    const OutputTables& outputColors;
+    const BitmapKernels::Kernels& bitmapKernels;
+    LineCache& lineCache;
+    LineDamage& lineDamage;
+
+    const RenderState* state = nullptr;
+    int scanline = 0;
+
+    const uint8_t* vram = nullptr;
+    std::vector<uint8_t> vramCopy;
+    const uint8_t* oam = nullptr;
+    uint64_t vramVersion = ~0ull;
+    uint64_t oamVersion = ~0ull;
+    uint64_t paletteVersion = ~0ull;
+
+    TileCache tileCache;
+    std::array<uint16_t, 512> paletteColors{};
+
+    SpriteTable sprites;
+    std::array<std::array<uint8_t, OBJ_COUNT>, SCREEN_HEIGHT> spriteBuckets{};
+    std::array<uint8_t, SCREEN_HEIGHT> spriteBucketSize{};
+
+    uint8_t windowEnable = 0;
+    std::array<uint16_t, 2> winH{};
+    uint16_t winIn = 0;
+    uint16_t winOut = 0;
+    bool windowValid = false;
+    alignas(16) std::array<MaskBuffer, 4> windowMasks{};
+    alignas(16) MaskBuffer objWindowMask{};
+
+    std::array<uint64_t, 4> bgLineSource{};
+
+    alignas(16) std::array<LineBuffer, 4> bgLine{};
+    alignas(16) LineBuffer objLine{};
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH> objPriority{};
+    alignas(16) MaskBuffer objWindow{};
+    alignas(16) MaskBuffer objSemiTransparent{};
+    bool objSemiTransparentOnLine = false;
+    alignas(16) LineBuffer composedLine{};
+};
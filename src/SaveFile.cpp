@@ -0,0 +1,224 @@
+#include "SaveFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(50);
+constexpr auto QUIET_PERIOD = std::chrono::milliseconds(250);
+constexpr auto MAX_FLUSH_DELAY = std::chrono::seconds(2);
+
+}
+
+SaveFile::SaveFile(size_t size, uint8_t fill)
+    : buffer(size, fill), capacity(size), erased(fill), bytes(buffer.data()), length(size) {
+}
+
+SaveFile::~SaveFile() {
+    unmap();
+}
+
+size_t SaveFile::existingSize(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : static_cast<size_t>(size);
+}
+
+bool SaveFile::map(const std::string& path, size_t size) {
+    unmap();
+    if (size == 0 || size > MAX_SIZE) return false;
+
+    size_t previousSize = existingSize(path);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), nullptr);
+    if (!view) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* address = MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!address) {
+        CloseHandle(view);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = view;
+#else
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0) return false;
+
+    if (previousSize < size && ::ftruncate(file, static_cast<off_t>(size)) != 0) {
+        ::close(file);
+        return false;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, file, 0);
+    if (address == MAP_FAILED) {
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+#endif
+
+    mapping = address;
+    bytes = static_cast<uint8_t*>(address);
+    length = size;
+    dirtySectors.store(0);
+
+    if (previousSize < size) {
+        std::memset(bytes + previousSize, erased, size - previousSize);
+        for (size_t sector = previousSize / SECTOR_SIZE; sector * SECTOR_SIZE < size; sector++) {
+            markDirty(sector * SECTOR_SIZE);
+        }
+    }
+
+    stopping = false;
+    flusher = std::thread(&SaveFile::flushLoop, this);
+    return true;
+}
+
+void SaveFile::unmap() {
+    if (!mapping) return;
+
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        stopping = true;
+    }
+    flushCondition.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+
+    flush();
+
+    buffer.assign(bytes, bytes + length);
+    releaseMapping();
+    bytes = buffer.data();
+}
+
+void SaveFile::reset() {
+    unmap();
+    buffer.assign(capacity, erased);
+    bytes = buffer.data();
+    length = capacity;
+}
+
+void SaveFile::releaseMapping() {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    ::munmap(mapping, length);
+    ::close(fd);
+    fd = -1;
+#endif
+    mapping = nullptr;
+}
+
+void SaveFile::fill(size_t offset, size_t count, uint8_t value) {
+    if (offset >= length) return;
+    count = std::min(count, length - offset);
+
+    std::memset(bytes + offset, value, count);
+    for (size_t sector = offset / SECTOR_SIZE; sector * SECTOR_SIZE < offset + count; sector++) {
+        markDirty(sector * SECTOR_SIZE);
+    }
+}
+
+void SaveFile::flush() {
+    if (!mapping) return;
+
+    uint32_t sectors = dirtySectors.exchange(0, std::memory_order_acquire);
+    size_t sector = 0;
+    while (sector < 32) {
+        if (!((sectors >> sector) & 1)) {
+            sector++;
+            continue;
+        }
+        size_t first = sector;
+        while (sector < 32 && ((sectors >> sector) & 1)) {
+            sector++;
+        }
+        syncRange(first * SECTOR_SIZE, (sector - first) * SECTOR_SIZE);
+    }
+}
+
+void SaveFile::syncRange(size_t offset, size_t count) {
+    if (offset >= length) return;
+    count = std::min(count, length - offset);
+
+#ifdef _WIN32
+    FlushViewOfFile(bytes + offset, count);
+    FlushFileBuffers(static_cast<HANDLE>(fileHandle));
+#else
+    size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % pageSize;
+    ::msync(bytes + start, offset + count - start, MS_SYNC);
+#endif
+}
+
+void SaveFile::flushLoop() {
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t lastGeneration = writeGeneration.load(std::memory_order_relaxed);
+    Clock::time_point lastWrite = Clock::now();
+    Clock::time_point pendingSince = lastWrite;
+    bool pending = false;
+
+    std::unique_lock<std::mutex> lock(flushMutex);
+    while (!stopping) {
+        flushCondition.wait_for(lock, POLL_INTERVAL, [this]() { return stopping; });
+        if (stopping) break;
+
+        Clock::time_point now = Clock::now();
+        uint64_t generation = writeGeneration.load(std::memory_order_relaxed);
+        if (generation != lastGeneration) {
+            lastGeneration = generation;
+            lastWrite = now;
+            if (!pending) {
+                pending = true;
+                pendingSince = now;
+            }
+        }
+
+        if (dirtySectors.load(std::memory_order_relaxed) == 0) {
+            pending = false;
+            continue;
+        }
+
+        if (now - lastWrite >= QUIET_PERIOD || now - pendingSince >= MAX_FLUSH_DELAY) {
+            lock.unlock();
+            flush();
+            lock.lock();
+            pending = false;
+        }
+    }
+}
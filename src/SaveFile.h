@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class SaveFile {
+public:
+    explicit SaveFile(size_t size, uint8_t fill = 0xFF);
+    ~SaveFile();
+
+    SaveFile(const SaveFile&) = delete;
+    SaveFile& operator=(const SaveFile&) = delete;
+
+    // Bytes past the end of an existing file start out erased.
+    bool map(const std::string& path, size_t size);
+    void unmap();
+    // Unmaps and erases the in-memory copy, for switching to a different game.
+    void reset();
+    bool isMapped() const { return mapping != nullptr; }
+
+    uint8_t* data() { return bytes; }
+    size_t size() const { return length; }
+    uint8_t& operator[](size_t index) { return bytes[index]; }
+    uint8_t operator[](size_t index) const { return bytes[index]; }
+
+    void markDirty(size_t offset) {
+        dirtySectors.fetch_or(1u << (offset / SECTOR_SIZE), std::memory_order_release);
+        writeGeneration.store(writeGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    void fill(size_t offset, size_t count, uint8_t value);
+    void flush();
+
+    static size_t existingSize(const std::string& path);
+
+    static constexpr size_t SECTOR_SIZE = 0x1000;
+    static constexpr size_t MAX_SIZE = 32 * SECTOR_SIZE;
+
+private:
+    void flushLoop();
+    void syncRange(size_t offset, size_t count);
+    void releaseMapping();
+
+    std::vector<uint8_t> buffer;
+    size_t capacity = 0;
+    uint8_t erased = 0xFF;
+    uint8_t* bytes = nullptr;
+    size_t length = 0;
+
+    void* mapping = nullptr;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    std::atomic<uint32_t> dirtySectors{0};
+    std::atomic<uint64_t> writeGeneration{0};
+
+    std::thread flusher;
+    std::mutex flushMutex;
+    std::condition_variable flushCondition;
+    bool stopping = false;
+};
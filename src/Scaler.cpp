@@ -0,0 +1,553 @@
+#include "Scaler.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace {
+
+struct Rows {
+    const uint32_t* above;
+    const uint32_t* row;
+    const uint32_t* below;
+};
+
+Rows sourceRows(const uint32_t* src, int width, int height, int y) {
+    return {src + std::max(y - 1, 0) * width, src + y * width, src + std::min(y + 1, height - 1) * width};
+}
+
+void scale2xPixel(const Rows& rows, int width, int x, uint32_t* out0, uint32_t* out1) {
+    int left = std::max(x - 1, 0);
+    int right = std::min(x + 1, width - 1);
+    uint32_t b = rows.above[x];
+    uint32_t d = rows.row[left];
+    uint32_t e = rows.row[x];
+    uint32_t f = rows.row[right];
+    uint32_t h = rows.below[x];
+
+    if (b != h && d != f) {
+        out0[x * 2] = d == b ? d : e;
+        out0[x * 2 + 1] = b == f ? f : e;
+        out1[x * 2] = d == h ? d : e;
+        out1[x * 2 + 1] = h == f ? f : e;
+    } else {
+        out0[x * 2] = out0[x * 2 + 1] = e;
+        out1[x * 2] = out1[x * 2 + 1] = e;
+    }
+}
+
+void scale3xPixel(const Rows& rows, int width, int x, uint32_t* out0, uint32_t* out1, uint32_t* out2) {
+    int left = std::max(x - 1, 0);
+    int right = std::min(x + 1, width - 1);
+    uint32_t a = rows.above[left];
+    uint32_t b = rows.above[x];
+    uint32_t c = rows.above[right];
+    uint32_t d = rows.row[left];
+    uint32_t e = rows.row[x];
+    uint32_t f = rows.row[right];
+    uint32_t g = rows.below[left];
+    uint32_t h = rows.below[x];
+    uint32_t i = rows.below[right];
+
+    uint32_t* p0 = out0 + x * 3;
+    uint32_t* p1 = out1 + x * 3;
+    uint32_t* p2 = out2 + x * 3;
+    if (b != h && d != f) {
+        p0[0] = d == b ? d : e;
+        p0[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+        p0[2] = b == f ? f : e;
+        p1[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+        p1[1] = e;
+        p1[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+        p2[0] = d == h ? d : e;
+        p2[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+        p2[2] = h == f ? f : e;
+    } else {
+        p0[0] = p0[1] = p0[2] = e;
+        p1[0] = p1[1] = p1[2] = e;
+        p2[0] = p2[1] = p2[2] = e;
+    }
+}
+
+#ifdef PPU_USE_SSE2
+__m128i load(const uint32_t* data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+void store(uint32_t* data, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value);
+}
+
+__m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Stores a0 b0 c0 a1 b1 c1 a2 b2 c2 a3 b3 c3.
+void storeInterleaved3(uint32_t* data, __m128i a, __m128i b, __m128i c) {
+    __m128 ab = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+    __m128 abHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+    __m128 ca = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));
+    __m128 caHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));
+    __m128 bc = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+    __m128 bcHigh = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+    store(data, _mm_castps_si128(_mm_shuffle_ps(ab, ca, _MM_SHUFFLE(3, 0, 1, 0))));
+    store(data + 4, _mm_castps_si128(_mm_shuffle_ps(bc, abHigh, _MM_SHUFFLE(1, 0, 3, 2))));
+    store(data + 8, _mm_castps_si128(_mm_shuffle_ps(caHigh, bcHigh, _MM_SHUFFLE(3, 2, 3, 0))));
+}
+
+void scale2xVector(const Rows& rows, int x, uint32_t* out0, uint32_t* out1) {
+    __m128i b = load(rows.above + x);
+    __m128i d = load(rows.row + x - 1);
+    __m128i e = load(rows.row + x);
+    __m128i f = load(rows.row + x + 1);
+    __m128i h = load(rows.below + x);
+
+    __m128i active = _mm_andnot_si128(_mm_cmpeq_epi32(b, h), _mm_andnot_si128(_mm_cmpeq_epi32(d, f), _mm_set1_epi32(-1)));
+    __m128i e0 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, b)), d, e);
+    __m128i e1 = select(_mm_and_si128(active, _mm_cmpeq_epi32(b, f)), f, e);
+    __m128i e2 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, h)), d, e);
+    __m128i e3 = select(_mm_and_si128(active, _mm_cmpeq_epi32(h, f)), f, e);
+
+    store(out0 + x * 2, _mm_unpacklo_epi32(e0, e1));
+    store(out0 + x * 2 + 4, _mm_unpackhi_epi32(e0, e1));
+    store(out1 + x * 2, _mm_unpacklo_epi32(e2, e3));
+    store(out1 + x * 2 + 4, _mm_unpackhi_epi32(e2, e3));
+}
+
+void scale3xVector(const Rows& rows, int x, uint32_t* out0, uint32_t* out1, uint32_t* out2) {
+    __m128i a = load(rows.above + x - 1);
+    __m128i b = load(rows.above + x);
+    __m128i c = load(rows.above + x + 1);
+    __m128i d = load(rows.row + x - 1);
+    __m128i e = load(rows.row + x);
+    __m128i f = load(rows.row + x + 1);
+    __m128i g = load(rows.below + x - 1);
+    __m128i h = load(rows.below + x);
+    __m128i i = load(rows.below + x + 1);
+
+    __m128i active = _mm_andnot_si128(_mm_cmpeq_epi32(b, h), _mm_andnot_si128(_mm_cmpeq_epi32(d, f), _mm_set1_epi32(-1)));
+    __m128i db = _mm_and_si128(active, _mm_cmpeq_epi32(d, b));
+    __m128i bf = _mm_and_si128(active, _mm_cmpeq_epi32(b, f));
+    __m128i dh = _mm_and_si128(active, _mm_cmpeq_epi32(d, h));
+    __m128i hf = _mm_and_si128(active, _mm_cmpeq_epi32(h, f));
+    __m128i ea = _mm_cmpeq_epi32(e, a);
+    __m128i ec = _mm_cmpeq_epi32(e, c);
+    __m128i eg = _mm_cmpeq_epi32(e, g);
+    __m128i ei = _mm_cmpeq_epi32(e, i);
+
+    __m128i e1 = select(_mm_or_si128(_mm_andnot_si128(ec, db), _mm_andnot_si128(ea, bf)), b, e);
+    __m128i e3 = select(_mm_or_si128(_mm_andnot_si128(eg, db), _mm_andnot_si128(ea, dh)), d, e);
+    __m128i e5 = select(_mm_or_si128(_mm_andnot_si128(ei, bf), _mm_andnot_si128(ec, hf)), f, e);
+    __m128i e7 = select(_mm_or_si128(_mm_andnot_si128(ei, dh), _mm_andnot_si128(eg, hf)), h, e);
+
+    storeInterleaved3(out0 + x * 3, select(db, d, e), e1, select(bf, f, e));
+    storeInterleaved3(out1 + x * 3, e3, e, e5);
+    storeInterleaved3(out2 + x * 3, select(dh, d, e), e7, select(hf, f, e));
+}
+#endif
+
+void scale2xRow(const Rows& rows, int width, bool vector, uint32_t* out0, uint32_t* out1) {
+    int x = 0;
+    scale2xPixel(rows, width, x++, out0, out1);
+#ifdef PPU_USE_SSE2
+    for (; vector && x + 4 < width; x += 4) {
+        scale2xVector(rows, x, out0, out1);
+    }
+#else
+    (void)vector;
+#endif
+    for (; x < width; x++) {
+        scale2xPixel(rows, width, x, out0, out1);
+    }
+}
+
+void scale3xRow(const Rows& rows, int width, bool vector, uint32_t* out0, uint32_t* out1, uint32_t* out2) {
+    int x = 0;
+    scale3xPixel(rows, width, x++, out0, out1, out2);
+#ifdef PPU_USE_SSE2
+    for (; vector && x + 4 < width; x += 4) {
+        scale3xVector(rows, x, out0, out1, out2);
+    }
+#else
+    (void)vector;
+#endif
+    for (; x < width; x++) {
+        scale3xPixel(rows, width, x, out0, out1, out2);
+    }
+}
+
+// 2xBR (Hyllian's xBR level 1 at 2x). Taps are named for the bottom-right
+// output pixel; the other three corners use the same rule turned a quarter
+// turn at a time.
+//
+//        A1 B1 C1
+//     A0 A  B  C  C4
+//     D0 D  E  F  F4
+//     G0 G  H  I  I4
+//        G5 H5 I5
+enum Tap { A, B, C, D, E, F, G, H, I, A0, D0, G0, A1, B1, C1, C4, F4, I4, G5, H5, I5, TAPS };
+
+constexpr int TAP_X[TAPS] = {-1, 0, 1, -1, 0, 1, -1, 0, 1, -2, -2, -2, -1, 0, 1, 2, 2, 2, -1, 0, 1};
+constexpr int TAP_Y[TAPS] = {-1, -1, -1, 0, 0, 0, 1, 1, 1, -1, 0, 1, -2, -2, -2, -1, 0, 1, 2, 2, 2};
+
+struct Rotation {
+    uint8_t tap[TAPS];
+    uint8_t n1, n2, n3;
+};
+
+constexpr int outputIndex(int x, int y) {
+    return (y > 0 ? 2 : 0) + (x > 0 ? 1 : 0);
+}
+
+constexpr std::array<Rotation, 4> makeRotations() {
+    std::array<Rotation, 4> rotations{};
+    for (int r = 0; r < 4; r++) {
+        auto rotate = [r](int& x, int& y) {
+            for (int i = 0; i < r; i++) {
+                int t = x;
+                x = y;
+                y = -t;
+            }
+        };
+        for (int tap = 0; tap < TAPS; tap++) {
+            int x = TAP_X[tap];
+            int y = TAP_Y[tap];
+            rotate(x, y);
+            rotations[r].tap[tap] = static_cast<uint8_t>((y + 2) * 5 + x + 2);
+        }
+        int x = 1, y = -1;
+        rotate(x, y);
+        rotations[r].n1 = static_cast<uint8_t>(outputIndex(x, y));
+        x = -1, y = 1;
+        rotate(x, y);
+        rotations[r].n2 = static_cast<uint8_t>(outputIndex(x, y));
+        x = 1, y = 1;
+        rotate(x, y);
+        rotations[r].n3 = static_cast<uint8_t>(outputIndex(x, y));
+    }
+    return rotations;
+}
+
+constexpr std::array<Rotation, 4> ROTATIONS = makeRotations();
+
+// Y, U and V packed as 8-bit fields so distances need no per-tap conversion.
+uint32_t toYUV(uint32_t color) {
+    int r = (color >> 16) & 0xFF;
+    int g = (color >> 8) & 0xFF;
+    int b = color & 0xFF;
+    int y = (77 * r + 150 * g + 29 * b) >> 8;
+    int u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+    int v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+    return (y << 16) | (std::clamp(u, 0, 255) << 8) | std::clamp(v, 0, 255);
+}
+
+int distance(uint32_t a, uint32_t b) {
+    return 48 * std::abs(static_cast<int>(a >> 16) - static_cast<int>(b >> 16)) +
+           7 * std::abs(static_cast<int>((a >> 8) & 0xFF) - static_cast<int>((b >> 8) & 0xFF)) +
+           6 * std::abs(static_cast<int>(a & 0xFF) - static_cast<int>(b & 0xFF));
+}
+
+// Moves dst weight/256 of the way towards src, keeping dst's alpha.
+uint32_t blend(uint32_t dst, uint32_t src, uint32_t weight) {
+    uint32_t keep = 256 - weight;
+    uint32_t rb = ((dst & 0xFF00FF) * keep + (src & 0xFF00FF) * weight) >> 8;
+    uint32_t g = ((dst & 0x00FF00) * keep + (src & 0x00FF00) * weight) >> 8;
+    return (dst & 0xFF000000) | (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+struct Neighbourhood {
+    uint32_t pixel[25];
+    uint32_t yuv[25];
+};
+
+void xbrCorner(const Neighbourhood& n, const Rotation& rotation, uint32_t* out) {
+    auto p = [&](Tap tap) { return n.pixel[rotation.tap[tap]]; };
+    auto df = [&](Tap a, Tap b) { return distance(n.yuv[rotation.tap[a]], n.yuv[rotation.tap[b]]); };
+    auto eq = [&](Tap a, Tap b) { return df(a, b) < 155; };
+
+    if (p(E) == p(H) || p(E) == p(F)) return;
+
+    int e = df(E, C) + df(E, G) + df(I, H5) + df(I, F4) + 4 * df(H, F);
+    int i = df(H, D) + df(H, I5) + df(F, I4) + df(F, B) + 4 * df(E, I);
+    uint32_t px = df(E, F) <= df(E, H) ? p(F) : p(H);
+
+    if (e < i && ((!eq(F, B) && !eq(H, D)) || (eq(E, I) && !eq(F, I4) && !eq(H, I5)) || eq(E, G) || eq(E, C))) {
+        int ke = df(F, G);
+        int ki = df(H, C);
+        bool left = ke * 2 <= ki && p(E) != p(G) && p(D) != p(G);
+        bool up = ke >= ki * 2 && p(E) != p(C) && p(B) != p(C);
+        if (left && up) {
+            out[rotation.n3] = blend(out[rotation.n3], px, 224);
+            out[rotation.n2] = blend(out[rotation.n2], px, 64);
+            out[rotation.n1] = out[rotation.n2];
+        } else if (left) {
+            out[rotation.n3] = blend(out[rotation.n3], px, 192);
+            out[rotation.n2] = blend(out[rotation.n2], px, 64);
+        } else if (up) {
+            out[rotation.n3] = blend(out[rotation.n3], px, 192);
+            out[rotation.n1] = blend(out[rotation.n1], px, 64);
+        } else {
+            out[rotation.n3] = blend(out[rotation.n3], px, 128);
+        }
+    } else if (e <= i) {
+        out[rotation.n3] = blend(out[rotation.n3], px, 128);
+    }
+}
+
+void xbr2xRow(const uint32_t* src, const uint32_t* yuv, int width, int height, int y, uint32_t* out0, uint32_t* out1) {
+    const uint32_t* pixelRows[5];
+    const uint32_t* yuvRows[5];
+    for (int row = 0; row < 5; row++) {
+        int sy = std::clamp(y + row - 2, 0, height - 1);
+        pixelRows[row] = src + sy * width;
+        yuvRows[row] = yuv + sy * width;
+    }
+
+    Neighbourhood n;
+    for (int x = 0; x < width; x++) {
+        uint32_t e = pixelRows[2][x];
+        uint32_t corners[4] = {e, e, e, e};
+
+        bool flat = pixelRows[1][x] == e && pixelRows[3][x] == e &&
+                    pixelRows[2][std::max(x - 1, 0)] == e && pixelRows[2][std::min(x + 1, width - 1)] == e;
+        if (!flat) {
+            for (int column = 0; column < 5; column++) {
+                int sx = std::clamp(x + column - 2, 0, width - 1);
+                for (int row = 0; row < 5; row++) {
+                    n.pixel[row * 5 + column] = pixelRows[row][sx];
+                    n.yuv[row * 5 + column] = yuvRows[row][sx];
+                }
+            }
+            for (const Rotation& rotation : ROTATIONS) {
+                xbrCorner(n, rotation, corners);
+            }
+        }
+
+        out0[x * 2] = corners[0];
+        out0[x * 2 + 1] = corners[1];
+        out1[x * 2] = corners[2];
+        out1[x * 2 + 1] = corners[3];
+    }
+}
+}
+
+Scaler::Scaler() = default;
+
+Scaler::~Scaler() {
+    setThreads(0);
+}
+
+int Scaler::factor(ScaleFilter filter) {
+    switch (filter) {
+        case ScaleFilter::Scale2x: return 2;
+        case ScaleFilter::Scale3x: return 3;
+        case ScaleFilter::Scale4x: return 4;
+        case ScaleFilter::XBR2x: return 2;
+        case ScaleFilter::XBR4x: return 4;
+        default: return 1;
+    }
+}
+
+void Scaler::setOutputSize(int width, int height) {
+    outputWidth = std::max(width, 0);
+    outputHeight = std::max(height, 0);
+}
+
+int Scaler::getOutputWidth() const {
+    return outputWidth && outputHeight ? outputWidth : SCREEN_WIDTH * getFactor();
+}
+
+int Scaler::getOutputHeight() const {
+    return outputWidth && outputHeight ? outputHeight : SCREEN_HEIGHT * getFactor();
+}
+
+void Scaler::setThreads(int count) {
+    count = std::clamp(count, 0, MAX_THREADS);
+    if (count == static_cast<int>(workers.size())) return;
+
+    {
+        std::lock_guard<std::mutex> lock(bandMutex);
+        stopping = true;
+    }
+    bandReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    stopping = false;
+    for (int i = 0; i < count; i++) {
+        workers.emplace_back(&Scaler::workerLoop, this);
+    }
+}
+
+void Scaler::scale(const uint32_t* src, uint32_t* dst, int dstPitch) {
+    int pitch = dstPitch / static_cast<int>(sizeof(uint32_t));
+    if (!outputWidth || !outputHeight) {
+        filterFrame(src, dst, pitch);
+        return;
+    }
+
+    int scale = getFactor();
+    int width = SCREEN_WIDTH * scale;
+    int height = SCREEN_HEIGHT * scale;
+    if (filter != ScaleFilter::None) {
+        filtered.resize(width * height);
+        filterFrame(src, filtered.data(), width);
+        src = filtered.data();
+    }
+
+    fitWidth = std::min(width * outputHeight / height, outputWidth);
+    fitHeight = std::min(height * outputWidth / width, outputHeight);
+    fitX = (outputWidth - fitWidth) / 2;
+    fitY = (outputHeight - fitHeight) / 2;
+    fitColumns.resize(fitWidth);
+    for (int x = 0; x < fitWidth; x++) {
+        fitColumns[x] = x * width / fitWidth;
+    }
+    runPass({Kernel::Fit, src, width, height, dst, pitch});
+}
+
+void Scaler::filterFrame(const uint32_t* src, uint32_t* dst, int pitch) {
+    switch (filter) {
+        case ScaleFilter::None:
+            for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                std::copy_n(src + y * SCREEN_WIDTH, SCREEN_WIDTH, dst + y * pitch);
+            }
+            break;
+        case ScaleFilter::Scale2x:
+            runPass({Kernel::Scale2x, src, SCREEN_WIDTH, SCREEN_HEIGHT, dst, pitch});
+            break;
+        case ScaleFilter::Scale3x:
+            runPass({Kernel::Scale3x, src, SCREEN_WIDTH, SCREEN_HEIGHT, dst, pitch});
+            break;
+        case ScaleFilter::Scale4x:
+            intermediate.resize(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+            runPass({Kernel::Scale2x, src, SCREEN_WIDTH, SCREEN_HEIGHT, intermediate.data(), SCREEN_WIDTH * 2});
+            runPass({Kernel::Scale2x, intermediate.data(), SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2, dst, pitch});
+            break;
+        case ScaleFilter::XBR2x:
+            runXBR2x(src, SCREEN_WIDTH, SCREEN_HEIGHT, dst, pitch);
+            break;
+        case ScaleFilter::XBR4x:
+            intermediate.resize(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+            runXBR2x(src, SCREEN_WIDTH, SCREEN_HEIGHT, intermediate.data(), SCREEN_WIDTH * 2);
+            runXBR2x(intermediate.data(), SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2, dst, pitch);
+            break;
+    }
+}
+
+void Scaler::runXBR2x(const uint32_t* src, int width, int height, uint32_t* dst, int pitch) {
+    yuv.resize(width * height);
+    runPass({Kernel::YUV, src, width, height, yuv.data(), width});
+    runPass({Kernel::XBR2x, src, width, height, dst, pitch});
+}
+
+void Scaler::runPass(const Pass& next) {
+    pass = next;
+    if (workers.empty()) {
+        runBand(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(bandMutex);
+        bandsQueued = static_cast<int>(workers.size()) + 1;
+        bandsTaken = 0;
+        bandsFinished = 0;
+    }
+    bandReady.notify_all();
+    runBands();
+
+    std::unique_lock<std::mutex> lock(bandMutex);
+    bandDone.wait(lock, [this]() { return bandsFinished == bandsQueued; });
+    bandsQueued = 0;
+    bandsTaken = 0;
+    bandsFinished = 0;
+}
+
+void Scaler::runBands() {
+    std::unique_lock<std::mutex> lock(bandMutex);
+    while (bandsTaken < bandsQueued) {
+        int band = bandsTaken++;
+        lock.unlock();
+
+        runBand(band);
+
+        lock.lock();
+        if (++bandsFinished == bandsQueued) {
+            bandDone.notify_one();
+        }
+    }
+}
+
+void Scaler::runBand(int band) {
+    int bands = static_cast<int>(workers.size()) + 1;
+    int height = pass.kernel == Kernel::Fit ? outputHeight : pass.height;
+    int bandRows = (height + bands - 1) / bands;
+    int first = band * bandRows;
+    int last = std::min(first + bandRows, height);
+
+    for (int y = first; y < last; y++) {
+        switch (pass.kernel) {
+            case Kernel::Scale2x: {
+                uint32_t* out = pass.dst + y * 2 * pass.dstPitch;
+                Rows rows = sourceRows(pass.src, pass.width, pass.height, y);
+                scale2xRow(rows, pass.width, vectorKernels, out, out + pass.dstPitch);
+                break;
+            }
+            case Kernel::Scale3x: {
+                uint32_t* out = pass.dst + y * 3 * pass.dstPitch;
+                Rows rows = sourceRows(pass.src, pass.width, pass.height, y);
+                scale3xRow(rows, pass.width, vectorKernels, out, out + pass.dstPitch, out + pass.dstPitch * 2);
+                break;
+            }
+            case Kernel::YUV:
+                std::transform(pass.src + y * pass.width, pass.src + (y + 1) * pass.width, pass.dst + y * pass.dstPitch,
+                               toYUV);
+                break;
+            case Kernel::XBR2x: {
+                uint32_t* out = pass.dst + y * 2 * pass.dstPitch;
+                xbr2xRow(pass.src, yuv.data(), pass.width, pass.height, y, out, out + pass.dstPitch);
+                break;
+            }
+            case Kernel::Fit:
+                fitRow(y, first);
+                break;
+        }
+    }
+}
+
+void Scaler::fitRow(int y, int first) {
+    uint32_t* out = pass.dst + y * pass.dstPitch;
+    if (y < fitY || y >= fitY + fitHeight) {
+        std::fill_n(out, outputWidth, 0xFF000000);
+        return;
+    }
+
+    // Most output rows repeat the one above, so only the first of each run is sampled.
+    int sourceY = (y - fitY) * pass.height / fitHeight;
+    if (y > first && y > fitY && (y - 1 - fitY) * pass.height / fitHeight == sourceY) {
+        std::copy_n(out - pass.dstPitch, outputWidth, out);
+        return;
+    }
+
+    const uint32_t* row = pass.src + sourceY * pass.width;
+    std::fill_n(out, fitX, 0xFF000000);
+    for (int x = 0; x < fitWidth; x++) {
+        out[fitX + x] = row[fitColumns[x]];
+    }
+    std::fill_n(out + fitX + fitWidth, outputWidth - fitX - fitWidth, 0xFF000000);
+}
+
+void Scaler::workerLoop() {
+    std::unique_lock<std::mutex> lock(bandMutex);
+    while (true) {
+        bandReady.wait(lock, [this]() { return stopping || bandsTaken < bandsQueued; });
+        if (stopping) break;
+
+        lock.unlock();
+        runBands();
+        lock.lock();
+    }
+}
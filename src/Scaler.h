@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class ScaleFilter : uint8_t {
+    None = 0,
+    Scale2x = 1,
+    Scale3x = 2,
+    Scale4x = 3,
+    XBR2x = 4,
+    XBR4x = 5
+};
+
+// Pixel-art upscalers for ARGB8888 frames. Rows are split into bands that
+// run on worker threads alongside the calling thread.
+class Scaler {
+public:
+    Scaler();
+    ~Scaler();
+
+    static int factor(ScaleFilter filter);
+
+    void setFilter(ScaleFilter filter) { this->filter = filter; }
+    ScaleFilter getFilter() const { return filter; }
+    int getFactor() const { return factor(filter); }
+
+    // A non-zero size makes scale() fit the filtered frame into it with
+    // nearest-neighbour sampling, centred and letterboxed in black.
+    void setOutputSize(int width, int height);
+    int getOutputWidth() const;
+    int getOutputHeight() const;
+
+    void setThreads(int count);
+    int getThreads() const { return static_cast<int>(workers.size()); }
+
+    // Off runs Scale2x/Scale3x with the scalar kernels only, for comparison.
+    void setVectorKernels(bool enabled) { vectorKernels = enabled; }
+
+    // dstPitch is in bytes; dst must hold getOutputWidth() x getOutputHeight().
+    void scale(const uint32_t* src, uint32_t* dst, int dstPitch);
+
+    static constexpr int MAX_THREADS = 15;
+
+private:
+    enum class Kernel : uint8_t {
+        Scale2x,
+        Scale3x,
+        YUV,
+        XBR2x,
+        Fit
+    };
+
+    struct Pass {
+        Kernel kernel = Kernel::Scale2x;
+        const uint32_t* src = nullptr;
+        int width = 0;
+        int height = 0;
+        uint32_t* dst = nullptr;
+        int dstPitch = 0;
+    };
+
+    void filterFrame(const uint32_t* src, uint32_t* dst, int pitch);
+    void runXBR2x(const uint32_t* src, int width, int height, uint32_t* dst, int pitch);
+    void runPass(const Pass& pass);
+    void runBands();
+    void runBand(int band);
+    void fitRow(int y, int first);
+    void workerLoop();
+
+    ScaleFilter filter = ScaleFilter::None;
+    bool vectorKernels = true;
+    std::vector<uint32_t> intermediate;
+    std::vector<uint32_t> filtered;
+    std::vector<uint32_t> yuv;
+
+    int outputWidth = 0;
+    int outputHeight = 0;
+    int fitX = 0;
+    int fitY = 0;
+    int fitWidth = 0;
+    int fitHeight = 0;
+    std::vector<int> fitColumns;
+
+    Pass pass;
+    std::vector<std::thread> workers;
+    std::mutex bandMutex;
+    std::condition_variable bandReady;
+    std::condition_variable bandDone;
+    int bandsQueued = 0;
+    int bandsTaken = 0;
+    int bandsFinished = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,234 @@
+#include "SharedExport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory counters must be lock-free to be usable across processes");
+
+namespace {
+
+size_t bytesPerPixel(PixelFormat format) {
+    return format == PixelFormat::ARGB8888 ? 4 : 2;
+}
+
+template <typename Slot>
+void beginWrite(Slot& slot) {
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename Slot>
+void endWrite(Slot& slot) {
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Moves an abandoned slot to the next even sequence, past anything a reader accepted.
+template <typename Slot>
+void resetSequence(Slot& slot) {
+    slot.sequence.store((slot.sequence.load(std::memory_order_relaxed) + 2) & ~1u, std::memory_order_relaxed);
+}
+
+uint32_t currentProcess() {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(::getpid());
+#endif
+}
+
+bool processRunning(uint32_t process) {
+#ifdef _WIN32
+    HANDLE handle = OpenProcess(SYNCHRONIZE, FALSE, process);
+    if (!handle) return false;
+    bool running = WaitForSingleObject(handle, 0) == WAIT_TIMEOUT;
+    CloseHandle(handle);
+    return running;
+#else
+    return process != 0 && (::kill(static_cast<pid_t>(process), 0) == 0 || errno == EPERM);
+#endif
+}
+}
+
+SharedExport::~SharedExport() {
+    close();
+}
+
+bool SharedExport::open(const std::string& name, uint32_t sampleRate) {
+    close();
+    if (name.empty()) return false;
+
+    bool created = true;
+#ifdef _WIN32
+    std::string path = "Local\\" + name.substr(name[0] == '/' ? 1 : 0);
+    HANDLE view = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                     static_cast<DWORD>(sizeof(Region)), path.c_str());
+    if (!view) return false;
+    // The mapping lives only while a handle is open, so an existing one is in use.
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(view);
+        return false;
+    }
+
+    void* address = MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Region));
+    if (!address) {
+        CloseHandle(view);
+        return false;
+    }
+
+    mappingHandle = view;
+#else
+    std::string path = name[0] == '/' ? name : "/" + name;
+    int file = ::shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (file < 0) {
+        if (errno != EEXIST) return false;
+        created = false;
+        file = ::shm_open(path.c_str(), O_RDWR, 0600);
+        struct stat info;
+        if (file < 0) return false;
+        if (::fstat(file, &info) != 0 || info.st_size != static_cast<off_t>(sizeof(Region))) {
+            ::close(file);
+            return false;
+        }
+    } else if (::ftruncate(file, static_cast<off_t>(sizeof(Region))) != 0) {
+        ::close(file);
+        ::shm_unlink(path.c_str());
+        return false;
+    }
+
+    void* address = ::mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) {
+        ::close(file);
+        if (created) ::shm_unlink(path.c_str());
+        return false;
+    }
+
+    fd = file;
+#endif
+
+    mappedName = path;
+    owned = created;
+    samplesPublished = 0;
+    if (created) {
+        // A new object is zero-filled, which is also where every counter starts.
+        region = new (address) Region;
+        writeHeader(sampleRate, 1);
+    } else {
+        region = std::launder(static_cast<Region*>(address));
+        if (!takeOver(*region)) {
+            close();
+            return false;
+        }
+        writeHeader(sampleRate, region->header.epoch + 1);
+    }
+    return true;
+}
+
+bool SharedExport::takeOver(Region& existing) {
+    Header& header = existing.header;
+    if (header.magic != MAGIC || header.version != VERSION) return false;
+    uint32_t previous = header.writerProcess.load(std::memory_order_acquire);
+    if (processRunning(previous)) return false;
+    if (!header.writerProcess.compare_exchange_strong(previous, currentProcess(), std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    header.magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    for (FrameSlot& slot : existing.frames) resetSequence(slot);
+    for (AudioSlot& slot : existing.audio) resetSequence(slot);
+
+    uint64_t blocks = header.audioBlocksPublished.load(std::memory_order_relaxed);
+    if (blocks > 0) {
+        const AudioSlot& last = existing.audio[(blocks - 1) % AUDIO_SLOTS];
+        samplesPublished = last.firstSample + last.count / 2;
+    }
+    return true;
+}
+
+void SharedExport::writeHeader(uint32_t sampleRate, uint32_t epoch) {
+    Header& header = region->header;
+    header.width = WIDTH;
+    header.height = HEIGHT;
+    header.frameSlots = FRAME_SLOTS;
+    header.audioSlots = AUDIO_SLOTS;
+    header.sampleRate = sampleRate;
+    header.channels = 2;
+    header.version = VERSION;
+    header.epoch = epoch;
+    header.writerProcess.store(currentProcess(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header.magic = MAGIC;
+}
+
+void SharedExport::close() {
+    if (!region) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(region);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    mappingHandle = nullptr;
+#else
+    ::munmap(region, sizeof(Region));
+    ::close(fd);
+    if (owned) ::shm_unlink(mappedName.c_str());
+    fd = -1;
+#endif
+    region = nullptr;
+    owned = false;
+    mappedName.clear();
+}
+
+void SharedExport::publishFrame(const void* pixels, int pitch, PixelFormat format) {
+    if (!region || !pixels) return;
+
+    uint64_t index = region->header.framesPublished.load(std::memory_order_relaxed);
+    FrameSlot& slot = region->frames[index % FRAME_SLOTS];
+    size_t rowBytes = WIDTH * bytesPerPixel(format);
+
+    beginWrite(slot);
+    slot.format = static_cast<uint32_t>(format);
+    slot.frame = index;
+    const uint8_t* src = static_cast<const uint8_t*>(pixels);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(slot.pixels);
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+        std::memcpy(dst + y * rowBytes, src + y * pitch, rowBytes);
+    }
+    endWrite(slot);
+
+    region->header.framesPublished.store(index + 1, std::memory_order_release);
+}
+
+void SharedExport::publishAudio(const int16_t* samples, size_t count) {
+    if (!region) return;
+
+    while (count > 0) {
+        uint64_t index = region->header.audioBlocksPublished.load(std::memory_order_relaxed);
+        AudioSlot& slot = region->audio[index % AUDIO_SLOTS];
+        size_t chunk = std::min<size_t>(count, AUDIO_BLOCK_SAMPLES);
+
+        beginWrite(slot);
+        slot.count = static_cast<uint32_t>(chunk);
+        slot.firstSample = samplesPublished;
+        std::memcpy(slot.samples, samples, chunk * sizeof(int16_t));
+        endWrite(slot);
+
+        region->header.audioBlocksPublished.store(index + 1, std::memory_order_release);
+        samplesPublished += chunk / 2;
+        samples += chunk;
+        count -= chunk;
+    }
+}
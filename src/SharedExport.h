@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include "FrameTarget.h"
+
+// Publishes completed frames and audio blocks into a named shared-memory
+// region so other local processes can read them without going through SDL.
+//
+// Every slot carries a sequence counter that is odd while the slot is being
+// written. A consumer picks the newest slot from the published counters, reads
+// the sequence (retrying while it is odd), uses the data in place and accepts
+// it only if the sequence is unchanged afterwards.
+//
+// open() fails if another live process is exporting under the same name. A
+// region left behind by a process that has exited is taken over: counters
+// carry on from where they stopped and the epoch is bumped, so a reader never
+// sees a sequence value it has already accepted. Contenders for the same
+// abandoned region claim it by swapping writerProcess from the dead process to
+// their own, so only one of them resets it.
+class SharedExport {
+public:
+    static constexpr uint32_t MAGIC = 0x41424753;
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t WIDTH = 240;
+    static constexpr uint32_t HEIGHT = 160;
+    static constexpr uint32_t FRAME_SLOTS = 4;
+    static constexpr uint32_t AUDIO_SLOTS = 16;
+    static constexpr uint32_t AUDIO_BLOCK_SAMPLES = 4096;
+
+    struct FrameSlot {
+        std::atomic<uint32_t> sequence;
+        uint32_t format;
+        uint64_t frame;
+        uint32_t pixels[WIDTH * HEIGHT];
+    };
+
+    struct AudioSlot {
+        std::atomic<uint32_t> sequence;
+        uint32_t count;
+        uint64_t firstSample;
+        int16_t samples[AUDIO_BLOCK_SAMPLES];
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t frameSlots;
+        uint32_t audioSlots;
+        uint32_t sampleRate;
+        uint32_t channels;
+        uint32_t epoch;
+        std::atomic<uint32_t> writerProcess;
+        std::atomic<uint64_t> framesPublished;
+        std::atomic<uint64_t> audioBlocksPublished;
+    };
+
+    struct Region {
+        Header header;
+        FrameSlot frames[FRAME_SLOTS];
+        AudioSlot audio[AUDIO_SLOTS];
+    };
+
+    SharedExport() = default;
+    ~SharedExport();
+
+    SharedExport(const SharedExport&) = delete;
+    SharedExport& operator=(const SharedExport&) = delete;
+
+    bool open(const std::string& name, uint32_t sampleRate);
+    void close();
+    bool isOpen() const { return region != nullptr; }
+
+    // Copies a frame in the format it was rendered in; rows are tightly packed.
+    void publishFrame(const void* pixels, int pitch, PixelFormat format);
+    void publishAudio(const int16_t* samples, size_t count);
+
+private:
+    bool takeOver(Region& existing);
+    void writeHeader(uint32_t sampleRate, uint32_t epoch);
+
+    Region* region = nullptr;
+    std::string mappedName;
+    bool owned = false;
+    uint64_t samplesPublished = 0;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
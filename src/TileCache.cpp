@@ -0,0 +1,15 @@
+#include "TileCache.h"
+
+TileCache::TileCache(const uint8_t* vram) : vram(vram) {
+    stale.markAll();
+}
+
+void TileCache::decode(uint32_t tile) {
+    const uint8_t* src = vram + tile * 32;
+    uint8_t* dst = &decoded[tile * 64];
+    for (int i = 0; i < 32; i++) {
+        dst[i * 2] = src[i] & 0xF;
+        dst[i * 2 + 1] = src[i] >> 4;
+    }
+    stale.clear(tile);
+}
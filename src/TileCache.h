@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include "MMU.h"
+
+class TileCache {
+public:
+    explicit TileCache(const uint8_t* vram = nullptr);
+
+    void setSource(const uint8_t* source) { vram = source; }
+    void invalidate(const VRAMDirtyBitmap& dirty) { stale.merge(dirty); }
+    void invalidateAll() { stale.markAll(); }
+
+    const uint8_t* row4bpp(uint32_t tile, int row) {
+        if (stale.test(tile)) {
+            decode(tile);
+        }
+        return &decoded[tile * 64 + row * 8];
+    }
+
+private:
+    void decode(uint32_t tile);
+
+    const uint8_t* vram;
+    VRAMDirtyBitmap stale;
+    std::array<uint8_t, VRAM_TILE_COUNT * 64> decoded{};
+};
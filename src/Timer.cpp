@@ -2,9 +2,21 @@
 #include "MMU.h"
 
 Timer::Timer(MMU& mmu) : mmu(mmu) {
+    connectIO();
     reset();
 }
 
+void Timer::connectIO() {
+    for (int i = 0; i < 4; i++) {
+        uint32_t base = 0x04000100 + i * 4;
+        mmu.setIOReadHandler(base, [this, i]() { return readCounter(i); });
+        // The reload register reads back as the running counter.
+        mmu.setIOWriteHandler(base, [this, i](uint16_t value) { writeReload(i, value); }, ByteMerge::Latched);
+        mmu.setIOReadHandler(base + 2, [this, i]() { return readControl(i); });
+        mmu.setIOWriteHandler(base + 2, [this, i](uint16_t value) { writeControl(i, value); });
+    }
+}
+
 void Timer::reset() {
     counter.fill(0);
     reload.fill(0);
@@ -19,6 +19,7 @@ public:
     void writeControl(int timer, uint16_t value);
     
 private:
+    void connectIO();
     void tick(int timer);
     void overflow(int timer);
     
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return buffers[backIndex]; }
+
+    void publish() {
+        uint8_t previous = state.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+    }
+
+    // True while the last published buffer has not been consumed yet.
+    bool pending() const { return state.load(std::memory_order_acquire) & FRESH; }
+
+    bool consume() {
+        if (!(state.load(std::memory_order_relaxed) & FRESH)) return false;
+        uint8_t previous = state.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> buffers{};
+    std::atomic<uint8_t> state{1};
+    uint8_t backIndex = 0;
+    uint8_t frontIndex = 2;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <array>
 
 namespace Utils {
 
@@ -42,4 +44,40 @@ inline void write32(uint8_t* data, uint32_t value) {
     data[3] = (value >> 24) & 0xFF;
 }
 
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    uint64_t hash = seed ^ (value * 0x9E3779B97F4A7C15ull);
+    hash = (hash ^ (hash >> 31)) * 0xBF58476D1CE4E5B9ull;
+    return hash ^ (hash >> 29);
+}
+
+template <size_t Bits>
+class DirtyBitmap {
+public:
+    static constexpr size_t WORDS = (Bits + 63) / 64;
+
+    void mark(size_t index) { words[index >> 6] |= 1ull << (index & 63); }
+    void clear(size_t index) { words[index >> 6] &= ~(1ull << (index & 63)); }
+    bool test(size_t index) const { return (words[index >> 6] >> (index & 63)) & 1; }
+    void markAll() { words.fill(~0ull); }
+    void clear() { words.fill(0); }
+
+    void merge(const DirtyBitmap& other) {
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i] |= other.words[i];
+        }
+    }
+
+    bool any() const {
+        for (uint64_t word : words) {
+            if (word) return true;
+        }
+        return false;
+    }
+
+    uint64_t word(size_t index) const { return words[index]; }
+
+private:
+    std::array<uint64_t, WORDS> words{};
+};
+
 }
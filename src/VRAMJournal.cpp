@@ -0,0 +1,67 @@
+#include "VRAMJournal.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+template <typename Visit>
+void forEachTile(const VRAMDirtyBitmap& dirty, Visit visit) {
+    for (size_t word = 0; word < VRAMDirtyBitmap::WORDS; word++) {
+        for (uint64_t bits = dirty.word(word); bits; bits &= bits - 1) {
+            visit(static_cast<uint32_t>(word * 64 + std::countr_zero(bits)) * 32);
+        }
+    }
+}
+}
+
+VRAMJournal::VRAMJournal() : deltas(CAPACITY) {
+}
+
+void VRAMJournal::reset(const uint8_t* live, uint64_t version) {
+    std::memcpy(base.data(), live, base.size());
+    baseVersion = version;
+    lastVersion = version;
+    head = 0;
+}
+
+void VRAMJournal::record(const uint8_t* live, const VRAMDirtyBitmap& dirty, uint64_t version) {
+    lastVersion = version;
+    Delta& next = deltas[(head + (version - baseVersion - 1)) % CAPACITY];
+    next.dirty = dirty;
+    next.tiles.clear();
+    forEachTile(dirty, [&](uint32_t offset) {
+        next.tiles.insert(next.tiles.end(), live + offset, live + offset + 32);
+    });
+}
+
+void VRAMJournal::trim(uint64_t version) {
+    version = std::min(version, lastVersion);
+    for (; baseVersion < version; baseVersion++) {
+        apply(base.data(), deltas[head]);
+        head = (head + 1) % CAPACITY;
+    }
+}
+
+bool VRAMJournal::update(uint8_t* copy, uint64_t& copyVersion, uint64_t version, VRAMDirtyBitmap& changed) const {
+    bool incremental = copyVersion >= baseVersion && copyVersion <= version;
+    if (!incremental) {
+        std::memcpy(copy, base.data(), base.size());
+        copyVersion = baseVersion;
+    }
+
+    for (uint64_t next = copyVersion + 1; next <= version; next++) {
+        apply(copy, delta(next));
+        changed.merge(delta(next).dirty);
+    }
+    copyVersion = version;
+    return incremental;
+}
+
+void VRAMJournal::apply(uint8_t* copy, const Delta& delta) {
+    const uint8_t* tile = delta.tiles.data();
+    forEachTile(delta.dirty, [&](uint32_t offset) {
+        std::memcpy(copy + offset, tile, 32);
+        tile += 32;
+    });
+}
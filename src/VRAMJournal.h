@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include "Renderer.h"
+
+// VRAM versions for render workers: a base copy plus, for each later
+// version, only the 32-byte tiles that changed. Versions are consecutive,
+// so a worker finds a delta by its version without reading anything the
+// emulation thread is still appending to.
+//
+// record() runs on the emulation thread. update() runs on workers and only
+// touches versions recorded before their strip was queued. reset() and
+// trim() must only run while no worker is rendering.
+class VRAMJournal {
+public:
+    // Two frames of one change per visible line.
+    static constexpr size_t CAPACITY = 2 * SCREEN_HEIGHT;
+
+    VRAMJournal();
+
+    void reset(const uint8_t* live, uint64_t version);
+    void record(const uint8_t* live, const VRAMDirtyBitmap& dirty, uint64_t version);
+
+    // Folds every delta up to and including version into the base copy.
+    void trim(uint64_t version);
+
+    // Brings copy from copyVersion to version and marks the tiles it rewrote
+    // in changed. Returns false if the whole copy was rebuilt from the base.
+    bool update(uint8_t* copy, uint64_t& copyVersion, uint64_t version, VRAMDirtyBitmap& changed) const;
+
+private:
+    struct Delta {
+        VRAMDirtyBitmap dirty;
+        std::vector<uint8_t> tiles;
+    };
+
+    const Delta& delta(uint64_t version) const { return deltas[(head + (version - baseVersion - 1)) % CAPACITY]; }
+    static void apply(uint8_t* copy, const Delta& delta);
+
+    std::array<uint8_t, 0x18000> base{};
+    uint64_t baseVersion = 0;
+    uint64_t lastVersion = 0;
+    size_t head = 0;
+    std::vector<Delta> deltas;
+};
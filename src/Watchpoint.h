@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+enum class WatchType : uint8_t {
+    Read = 1,
+    Write = 2,
+    ReadWrite = 3
+};
+
+struct Watchpoint {
+    uint32_t start;
+    uint32_t end;
+    WatchType type;
+};
+
+struct MemoryAccess {
+    uint32_t address;
+    uint32_t value;
+    uint32_t pc;
+    uint8_t size;
+    bool write;
+};
+
+using WatchCallback = std::function<void(const MemoryAccess&)>;
@@ -2,8 +2,32 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <bitset>
 #include "GBA.h"
 #include "PPU.h"
+#include "TripleBuffer.h"
+#include "PresentDamage.h"
+#include "SPSCQueue.h"
+#include "Capture.h"
+#include "Scaler.h"
+
+struct Frame {
+    std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> pixels;
+    std::bitset<SCREEN_HEIGHT> dirty;
+};
+
+struct KeyEvent {
+    int key;
+    bool pressed;
+};
+
+constexpr int TEST_FRAME_LIMIT = 120;
+constexpr double FRAME_SECONDS = 280896.0 / 16777216.0;
 
 bool checkTestResult(const uint32_t* framebuffer) {
     int passedTextPixels = 0;
@@ -33,18 +57,164 @@ bool checkTestResult(const uint32_t* framebuffer) {
     return passedTextPixels >= failedTextPixels;
 }
 
+void reportLineSkipping(const GBA& gba) {
+    LineSkipStats stats = gba.getLineSkipStats();
+    uint64_t total = stats.hits + stats.misses;
+    double rate = total ? stats.hits * 100.0 / total : 0.0;
+    std::cout << "Unchanged lines reused: " << stats.hits << " of " << total << " (" << rate << "%)" << std::endl;
+}
+
+void captureFrame(GBA& gba, Capture& capture, const uint32_t* pixels) {
+    const std::vector<int16_t>& samples = gba.getAudioSamples();
+    capture.pushFrame(pixels);
+    capture.pushAudio(samples.data(), samples.size());
+}
+
+ColorProfile parseColorProfile(const char* name) {
+    if (strcmp(name, "gba") == 0) return ColorProfile::GBA;
+    if (strcmp(name, "gba-sp") == 0) return ColorProfile::GBASP;
+    return ColorProfile::None;
+}
+
+ScaleFilter parseScaleFilter(const char* name) {
+    if (strcmp(name, "scale2x") == 0) return ScaleFilter::Scale2x;
+    if (strcmp(name, "scale3x") == 0) return ScaleFilter::Scale3x;
+    if (strcmp(name, "scale4x") == 0) return ScaleFilter::Scale4x;
+    if (strcmp(name, "xbr2x") == 0) return ScaleFilter::XBR2x;
+    if (strcmp(name, "xbr4x") == 0) return ScaleFilter::XBR4x;
+    return ScaleFilter::None;
+}
+
+bool parseOutputSize(const char* text, int& width, int& height) {
+    if (strcmp(text, "4k") == 0) {
+        width = 3840;
+        height = 2160;
+        return true;
+    }
+    return sscanf(text, "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+void reportCapture(const Capture& capture) {
+    std::cout << "Capture: " << capture.getFramesWritten() << " frames written, " << capture.getDroppedFrames()
+              << " dropped, " << capture.getDroppedSamples() << " audio samples dropped" << std::endl;
+}
+
+// Locks the rows from the first to the last dirty line and copies them in.
+// Locked texture memory does not keep its old contents, so clean lines
+// between them are copied too. If locking fails, each dirty span is uploaded
+// with SDL_UpdateTexture instead.
+void uploadDirtyLines(SDL_Texture* texture, const Frame& frame) {
+    int first = 0;
+    while (first < SCREEN_HEIGHT && !frame.dirty[first]) first++;
+    if (first == SCREEN_HEIGHT) return;
+    int last = SCREEN_HEIGHT - 1;
+    while (!frame.dirty[last]) last--;
+
+    SDL_Rect locked = {0, first, SCREEN_WIDTH, last - first + 1};
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, &locked, &pixels, &pitch) == 0) {
+        for (int line = first; line <= last; line++) {
+            std::memcpy(static_cast<uint8_t*>(pixels) + (line - first) * pitch, &frame.pixels[line * SCREEN_WIDTH],
+                        SCREEN_WIDTH * sizeof(uint32_t));
+        }
+        SDL_UnlockTexture(texture);
+        return;
+    }
+
+    for (int line = first; line <= last; line++) {
+        if (!frame.dirty[line]) continue;
+
+        int start = line;
+        while (line < last && frame.dirty[line + 1]) line++;
+        SDL_Rect rect = {0, start, SCREEN_WIDTH, line - start + 1};
+        SDL_UpdateTexture(texture, &rect, &frame.pixels[start * SCREEN_WIDTH], SCREEN_WIDTH * sizeof(uint32_t));
+    }
+}
+
+void emulationLoop(GBA& gba, TripleBuffer<Frame>& frames, SPSCQueue<KeyEvent, 64>& keyEvents, Capture& capture,
+                   std::atomic<bool>& running, std::atomic<uint32_t>& emulatedFrames) {
+    using Clock = std::chrono::steady_clock;
+    const auto frameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(FRAME_SECONDS));
+
+    PresentDamage damage;
+
+    Clock::time_point deadline = Clock::now();
+    while (running.load(std::memory_order_relaxed)) {
+        KeyEvent event;
+        while (keyEvents.pop(event)) {
+            gba.updateKey(event.key, event.pressed);
+        }
+
+        Frame& frame = frames.back();
+        gba.setFrameTarget(frame.pixels.data(), SCREEN_WIDTH * sizeof(uint32_t), PixelFormat::ARGB8888);
+        gba.runFrame();
+        captureFrame(gba, capture, frame.pixels.data());
+
+        frame.dirty = damage.next(gba.getDirtyLines(), frames.pending());
+        frames.publish();
+        emulatedFrames.fetch_add(1, std::memory_order_relaxed);
+
+        deadline += frameTime;
+        Clock::time_point now = Clock::now();
+        if (deadline < now) {
+            deadline = now;
+        } else {
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+    gba.setFrameTarget(nullptr, 0, PixelFormat::ARGB8888);
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <rom.gba> [--test]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <rom.gba> [--test] [--render-threads N] [--skip-lines]"
+                  << " [--scaler scale2x|scale3x|scale4x|xbr2x|xbr4x] [--scaler-threads N]"
+                  << " [--scaler-output 4k|WIDTHxHEIGHT]"
+                  << " [--capture-video out.y4m|out.rgb]"
+                  << " [--capture-audio out.wav (continues in out.001.wav, out.002.wav, ... every 4 GiB)]"
+                  << " [--export-shm name]"
+                  << " [--color gba|gba-sp]" << std::endl;
         return 1;
     }
 
     bool testMode = false;
+    int renderThreads = 0;
+    bool skipLines = false;
+    ScaleFilter scaleFilter = ScaleFilter::None;
+    int scalerThreads = 0;
+    int outputWidth = 0;
+    int outputHeight = 0;
+    std::string captureVideo;
+    std::string captureAudio;
+    std::string exportName;
+    ColorProfile colorProfile = ColorProfile::None;
     std::string romPath;
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--test") == 0) {
             testMode = true;
+        } else if (strcmp(argv[i], "--render-threads") == 0 && i + 1 < argc) {
+            renderThreads = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--skip-lines") == 0) {
+            skipLines = true;
+        } else if (strcmp(argv[i], "--scaler") == 0 && i + 1 < argc) {
+            scaleFilter = parseScaleFilter(argv[++i]);
+        } else if (strcmp(argv[i], "--scaler-threads") == 0 && i + 1 < argc) {
+            scalerThreads = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scaler-output") == 0 && i + 1 < argc) {
+            if (!parseOutputSize(argv[++i], outputWidth, outputHeight)) {
+                std::cerr << "Invalid scaler output size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--capture-video") == 0 && i + 1 < argc) {
+            captureVideo = argv[++i];
+        } else if (strcmp(argv[i], "--capture-audio") == 0 && i + 1 < argc) {
+            captureAudio = argv[++i];
+        } else if (strcmp(argv[i], "--export-shm") == 0 && i + 1 < argc) {
+            exportName = argv[++i];
+        } else if (strcmp(argv[i], "--color") == 0 && i + 1 < argc) {
+            colorProfile = parseColorProfile(argv[++i]);
         } else {
             romPath = argv[i];
         }
@@ -78,7 +248,7 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) {
         std::cerr << "SDL_CreateRenderer failed: " << SDL_GetError() << std::endl;
         SDL_DestroyWindow(window);
@@ -86,12 +256,20 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    Scaler scaler;
+    scaler.setFilter(testMode ? ScaleFilter::None : scaleFilter);
+    scaler.setThreads(scalerThreads);
+    if (!testMode) {
+        scaler.setOutputSize(outputWidth, outputHeight);
+    }
+    bool scaling = scaler.getOutputWidth() != SCREEN_WIDTH || scaler.getOutputHeight() != SCREEN_HEIGHT;
+
     SDL_Texture* texture = SDL_CreateTexture(
         renderer,
         SDL_PIXELFORMAT_ARGB8888,
         SDL_TEXTUREACCESS_STREAMING,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT
+        scaler.getOutputWidth(),
+        scaler.getOutputHeight()
     );
 
     if (!texture) {
@@ -111,17 +289,55 @@ int main(int argc, char* argv[]) {
         SDL_Quit();
         return 1;
     }
+    gba.setRenderThreads(renderThreads);
+    gba.setLineSkipping(skipLines);
+    gba.setColorProfile(colorProfile);
+    if (!exportName.empty() && !gba.openSharedExport(exportName)) {
+        std::cerr << "Failed to create shared memory export: " << exportName << std::endl;
+    }
 
-    bool running = true;
-    Uint32 frameStart;
-    int frameCount = 0;
-    Uint32 fpsTimer = SDL_GetTicks();
-    int testFrames = 0;
-    const int TEST_FRAME_LIMIT = 120;
+    Capture capture;
+    bool capturing = !captureVideo.empty() || !captureAudio.empty();
+    if (capturing) {
+        bool y4m = captureVideo.size() >= 4 && captureVideo.compare(captureVideo.size() - 4, 4, ".y4m") == 0;
+        if (!capture.start(captureVideo, y4m ? Capture::VideoFormat::Y4M : Capture::VideoFormat::RawRGB, captureAudio)) {
+            std::cerr << "Failed to open capture output" << std::endl;
+            capturing = false;
+        }
+    }
 
-    while (running) {
-        frameStart = SDL_GetTicks();
+    if (testMode) {
+        for (int frame = 0; frame < TEST_FRAME_LIMIT; frame++) {
+            gba.runFrame();
+            captureFrame(gba, capture, gba.getFramebuffer());
+        }
+        bool passed = checkTestResult(gba.getFramebuffer());
+        std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+        if (skipLines) {
+            reportLineSkipping(gba);
+        }
+        if (capturing) {
+            capture.stop();
+            reportCapture(capture);
+        }
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return passed ? 0 : 1;
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint32_t> emulatedFrames{0};
+    auto frames = std::make_unique<TripleBuffer<Frame>>();
+    SPSCQueue<KeyEvent, 64> keyEvents;
+    std::thread emulation(emulationLoop, std::ref(gba), std::ref(*frames), std::ref(keyEvents),
+                          std::ref(capture), std::ref(running), std::ref(emulatedFrames));
 
+    uint32_t fpsFrames = 0;
+    Uint32 fpsTimer = SDL_GetTicks();
+
+    while (running.load(std::memory_order_relaxed)) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
@@ -145,45 +361,47 @@ int main(int argc, char* argv[]) {
                 }
 
                 if (key != -1) {
-                    gba.updateKey(key, pressed);
+                    keyEvents.push({key, pressed});
                 }
             }
         }
 
-        gba.runFrame();
-
-        SDL_UpdateTexture(texture, nullptr, gba.getFramebuffer(), SCREEN_WIDTH * sizeof(uint32_t));
-
-        if (!testMode) {
+        if (frames->consume()) {
+            void* pixels;
+            int pitch;
+            const Frame& frame = frames->front();
+            if (!scaling) {
+                uploadDirtyLines(texture, frame);
+            } else if (frame.dirty.any() && SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+                scaler.scale(frame.pixels.data(), static_cast<uint32_t*>(pixels), pitch);
+                SDL_UnlockTexture(texture);
+            }
             SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, texture, nullptr, nullptr);
             SDL_RenderPresent(renderer);
+        } else {
+            SDL_Delay(1);
         }
 
-        frameCount++;
-        testFrames++;
-
-        if (testMode && testFrames >= TEST_FRAME_LIMIT) {
-            bool passed = checkTestResult(gba.getFramebuffer());
-            std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
-            SDL_DestroyTexture(texture);
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
-            return passed ? 0 : 1;
+        Uint32 elapsed = SDL_GetTicks() - fpsTimer;
+        if (elapsed >= 1000) {
+            uint32_t total = emulatedFrames.load(std::memory_order_relaxed);
+            float fps = (total - fpsFrames) * 1000.0f / elapsed;
+            char newTitle[256];
+            snprintf(newTitle, sizeof(newTitle), "GBA Emulator - %.1f fps", fps);
+            SDL_SetWindowTitle(window, newTitle);
+            fpsFrames = total;
+            fpsTimer = SDL_GetTicks();
         }
+    }
 
-        if (!testMode) {
-            Uint32 elapsed = SDL_GetTicks() - fpsTimer;
-            if (elapsed >= 1000) {
-                float fps = frameCount * 1000.0f / elapsed;
-                char newTitle[256];
-                snprintf(newTitle, sizeof(newTitle), "GBA Emulator - %.1f fps", fps);
-                SDL_SetWindowTitle(window, newTitle);
-                frameCount = 0;
-                fpsTimer = SDL_GetTicks();
-            }
-        }
+    emulation.join();
+    if (skipLines) {
+        reportLineSkipping(gba);
+    }
+    if (capturing) {
+        capture.stop();
+        reportCapture(capture);
     }
 
     SDL_DestroyTexture(texture);
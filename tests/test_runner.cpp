@@ -1,11 +1,38 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
 #include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <vector>
 #include "../src/GBA.h"
 #include "../src/CPU.h"
 #include "../src/MMU.h"
 #include "../src/PPU.h"
+#include "../src/DMA.h"
+#include "../src/Timer.h"
+#include "../src/Compositor.h"
+#include "../src/BitmapKernels.h"
+#include "../src/Scaler.h"
+#include "../src/SharedExport.h"
+#include "../src/Capture.h"
+#include "../src/PresentDamage.h"
+#include "../src/ColorCorrection.h"
+#include <random>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+int failures = 0;
+
+void check(bool passed, const std::string& name) {
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << name << std::endl;
+    if (!passed) failures++;
+}
 
 class TestRunner {
 public:
@@ -121,6 +148,1114 @@ void testCPUBasics() {
     }
 }
 
+void testIOByteWrites() {
+    std::cout << "\n=== IO Byte Write Tests ===" << std::endl;
+
+    MMU mmu;
+    DMA dma(mmu);
+
+    mmu.write16(0x04000202, 0x0001);
+    mmu.setIF(0x0101);
+    mmu.write8(0x04000203, 0x01);
+    check(mmu.getIF() == 0x0001, "IF byte write acknowledges only its own bits");
+    mmu.write8(0x04000202, 0x01);
+    check(mmu.getIF() == 0x0000, "IF low byte write acknowledges VBlank");
+
+    mmu.write16(0x02000000, 0x1234);
+    mmu.write32(0x040000D4, 0x02000000);
+    mmu.write32(0x040000D8, 0x02000100);
+    mmu.write16(0x040000DC, 1);
+    mmu.write16(0x040000DE, 0x8000);
+    check(mmu.read16(0x02000100) == 0x1234, "DMA3 immediate transfer runs");
+    check(!(mmu.read16(0x040000DE) & 0x8000), "DMA3 enable clears after transfer");
+
+    mmu.write16(0x02000100, 0);
+    mmu.write8(0x040000DE, 0x00);
+    check(mmu.read16(0x02000100) == 0, "DMA control byte write does not re-trigger");
+
+    Timer timer(mmu);
+    mmu.write16(0x04000100, 0x1234);
+    mmu.write16(0x04000102, 0x0080);
+    timer.step(0x57);
+    mmu.write8(0x04000101, 0xAB);
+    mmu.write16(0x04000102, 0x0000);
+    mmu.write16(0x04000102, 0x0080);
+    check(mmu.read16(0x04000100) == 0xAB34, "timer reload byte write keeps the latched low byte, not the counter");
+}
+
+template <size_t Bits>
+std::vector<size_t> dirtyEntries(const Utils::DirtyBitmap<Bits>& bitmap) {
+    std::vector<size_t> entries;
+    for (size_t i = 0; i < Bits; i++) {
+        if (bitmap.test(i)) entries.push_back(i);
+    }
+    return entries;
+}
+
+void testDirtyMarking() {
+    std::cout << "\n=== Dirty Marking Tests ===" << std::endl;
+
+    MMU mmu;
+    using Entries = std::vector<size_t>;
+    auto marks = [&](auto write, const Entries& vram, const Entries& oam, const Entries& palette) {
+        mmu.clearVRAMDirty();
+        mmu.clearOAMDirty();
+        mmu.clearPaletteDirty();
+        write();
+        return dirtyEntries(mmu.getVRAMDirty()) == vram && dirtyEntries(mmu.getOAMDirty()) == oam &&
+               dirtyEntries(mmu.getPaletteDirty()) == palette;
+    };
+
+    check(marks([&] { mmu.write16(0x06000040, 1); }, {2}, {}, {}), "16-bit VRAM write marks its tile");
+    check(marks([&] { mmu.write32(0x060007FC, 1); }, {63}, {}, {}), "32-bit VRAM write marks its tile");
+    check(marks([&] { mmu.write8(0x06000061, 1); }, {3}, {}, {}), "8-bit BG VRAM write marks its tile");
+    check(marks([&] { mmu.write16(0x06018020, 1); }, {0x801}, {}, {}), "16-bit write to mirrored VRAM marks the OBJ tile");
+    check(marks([&] { mmu.write32(0x0601FFFC, 1); }, {0xBFF}, {}, {}), "32-bit write to mirrored VRAM marks the last tile");
+    check(marks([&] { mmu.write8(0x06010000, 1); mmu.write8(0x06018001, 1); }, {}, {}, {}),
+          "8-bit OBJ VRAM writes are ignored in tile modes");
+    mmu.write16(0x04000000, 0x0003);
+    check(marks([&] { mmu.write8(0x06012345, 1); }, {0x91A}, {}, {}), "8-bit write to bitmap VRAM marks its tile");
+    mmu.write16(0x04000000, 0x0000);
+
+    check(marks([&] { mmu.write16(0x07000012, 1); }, {}, {2}, {}), "16-bit OAM write marks its entry");
+    check(marks([&] { mmu.write32(0x0700003C, 1); }, {}, {7}, {}), "32-bit OAM write marks its entry");
+    check(marks([&] { mmu.write8(0x07000008, 1); }, {}, {}, {}), "8-bit OAM writes are ignored");
+
+    check(marks([&] { mmu.write16(0x05000222, 1); }, {}, {}, {17}), "16-bit palette write marks its bank");
+    check(marks([&] { mmu.write32(0x050003FC, 1); }, {}, {}, {31}), "32-bit palette write marks its bank");
+    check(marks([&] { mmu.write8(0x05000041, 1); }, {}, {}, {2}), "8-bit palette write marks its bank");
+}
+
+#ifdef GBA_WATCHPOINTS
+void testWatchpoints() {
+    std::cout << "\n=== Watchpoint Tests ===" << std::endl;
+
+    MMU mmu;
+    int hits = 0;
+    mmu.setWatchCallback([&](const MemoryAccess&) { hits++; });
+    auto fires = [&](auto access) {
+        hits = 0;
+        access();
+        return hits == 1;
+    };
+    auto silent = [&](auto access) {
+        hits = 0;
+        access();
+        return hits == 0;
+    };
+
+    mmu.addWatchpoint(0x02000100, 4, WatchType::Write);
+    check(fires([&] { mmu.write8(0x02000102, 1); }) && fires([&] { mmu.write32(0x02000100, 1); }) &&
+          fires([&] { mmu.write16(0x02000102, 1); }), "write inside a watched range fires");
+    check(silent([&] { mmu.write8(0x020000FF, 1); }) && silent([&] { mmu.write8(0x02000104, 1); }) &&
+          silent([&] { mmu.write32(0x020000FC, 1); }) && silent([&] { mmu.write16(0x02000104, 1); }),
+          "writes next to a watched range do not fire");
+    check(silent([&] { mmu.read32(0x02000100); }), "write watchpoint ignores reads");
+    mmu.clearWatchpoints();
+
+    // 0x0200FFFE-0x02010001 spans two 64 KiB watch pages.
+    mmu.addWatchpoint(0x0200FFFE, 4, WatchType::ReadWrite);
+    check(fires([&] { mmu.read8(0x02010001); }) && fires([&] { mmu.read16(0x0200FFFE); }) &&
+          fires([&] { mmu.write32(0x0200FFFC, 1); }) && fires([&] { mmu.write32(0x02010000, 1); }),
+          "watchpoint spanning a page boundary fires on both pages");
+    check(silent([&] { mmu.read8(0x0200FFFD); }) && silent([&] { mmu.read8(0x02010002); }) &&
+          silent([&] { mmu.write32(0x02010004, 1); }), "page-spanning watchpoint ignores its neighbours");
+    mmu.removeWatchpoint(0x0200FFFE);
+    check(silent([&] { mmu.read8(0x02010001); }), "removed watchpoint stops firing");
+}
+#endif
+
+std::vector<uint8_t> eepromCommand(bool read, uint32_t block, int addressBits, uint64_t data) {
+    std::vector<uint8_t> bits = {1, static_cast<uint8_t>(read ? 1 : 0)};
+    for (int i = addressBits - 1; i >= 0; i--) {
+        bits.push_back((block >> i) & 1);
+    }
+    if (!read) {
+        for (int i = 63; i >= 0; i--) {
+            bits.push_back((data >> i) & 1);
+        }
+    }
+    bits.push_back(0);
+    return bits;
+}
+
+uint64_t eepromData(const uint8_t* bits) {
+    uint64_t data = 0;
+    for (int i = 4; i < 68; i++) {
+        data = (data << 1) | (bits[i] & 1);
+    }
+    return data;
+}
+
+void testEEPROM() {
+    std::cout << "\n=== EEPROM Tests ===" << std::endl;
+
+    EEPROM eeprom;
+    check(eeprom.read() == 1, "EEPROM reads 1 when idle");
+
+    std::vector<uint8_t> bits = eepromCommand(false, 5, 6, 0x0123456789ABCDEFull);
+    eeprom.writeCommand(bits.data(), static_cast<uint32_t>(bits.size()));
+    check(bits.size() == 73 && eeprom.getSize() == EEPROMSize::EEPROM512, "73-bit write selects 512-byte EEPROM");
+
+    bits = eepromCommand(true, 5, 6, 0);
+    eeprom.writeCommand(bits.data(), static_cast<uint32_t>(bits.size()));
+    uint8_t response[EEPROM::READ_BITS];
+    eeprom.readBits(response, EEPROM::READ_BITS);
+    check(bits.size() == 9 && eepromData(response) == 0x0123456789ABCDEFull, "9-bit read returns the written block");
+    check(eeprom.read() == 1, "EEPROM returns to idle after 68 bits");
+
+    bits = eepromCommand(false, 0x3FF, 14, 0xFEDCBA9876543210ull);
+    eeprom.writeCommand(bits.data(), static_cast<uint32_t>(bits.size()));
+    check(bits.size() == 81 && eeprom.getSize() == EEPROMSize::EEPROM8K, "81-bit write selects 8KB EEPROM");
+
+    bits = eepromCommand(true, 0x3FF, 14, 0);
+    for (uint8_t bit : bits) {
+        eeprom.write(bit);
+    }
+    for (uint8_t& bit : response) {
+        bit = static_cast<uint8_t>(eeprom.read());
+    }
+    check(bits.size() == 17 && eepromData(response) == 0xFEDCBA9876543210ull, "bit-serial 17-bit read returns the block");
+
+    bits = eepromCommand(false, 0x12, 14, 0x00FF00FF00FF00FFull);
+    for (uint8_t bit : bits) {
+        eeprom.write(bit);
+    }
+    bits = eepromCommand(true, 0x12, 14, 0);
+    eeprom.writeCommand(bits.data(), static_cast<uint32_t>(bits.size()));
+    eeprom.readBits(response, EEPROM::READ_BITS);
+    check(eepromData(response) == 0x00FF00FF00FF00FFull, "bit-serial write is read back");
+
+    std::filesystem::path romPath = std::filesystem::temp_directory_path() / "gba_eeprom_test.gba";
+    {
+        std::ofstream rom(romPath, std::ios::binary);
+        std::string image(0x1000, '\0');
+        image.replace(0x200, 8, "EEPROM_V");
+        rom.write(image.data(), image.size());
+    }
+
+    MMU mmu;
+    DMA dma(mmu);
+    mmu.loadROM(romPath.string());
+    std::filesystem::remove(romPath);
+
+    auto dmaTransfer = [&](uint32_t source, uint32_t dest, uint16_t count) {
+        mmu.write32(0x040000D4, source);
+        mmu.write32(0x040000D8, dest);
+        mmu.write16(0x040000DC, count);
+        mmu.write16(0x040000DE, 0x8000);
+    };
+    auto stage = [&](const std::vector<uint8_t>& command) {
+        for (size_t i = 0; i < command.size(); i++) {
+            mmu.write16(0x02000000 + static_cast<uint32_t>(i) * 2, command[i]);
+        }
+        dmaTransfer(0x02000000, 0x0D000000, static_cast<uint16_t>(command.size()));
+    };
+
+    stage(eepromCommand(false, 0x155, 14, 0xA5A5A5A55A5A5A5Aull));
+    check(mmu.getEEPROM().getSize() == EEPROMSize::EEPROM8K, "DMA3 81-bit write selects 8KB EEPROM");
+    stage(eepromCommand(true, 0x155, 14, 0));
+    dmaTransfer(0x0D000000, 0x02001000, EEPROM::READ_BITS);
+    for (uint32_t i = 0; i < EEPROM::READ_BITS; i++) {
+        response[i] = static_cast<uint8_t>(mmu.read16(0x02001000 + i * 2));
+    }
+    check(eepromData(response) == 0xA5A5A5A55A5A5A5Aull, "DMA3 fast path reads back the block");
+
+    // 32-bit accesses reach the EEPROM as two halfwords: two bits each.
+    bits = eepromCommand(true, 0x155, 14, 0);
+    for (size_t i = 0; i + 1 < bits.size(); i += 2) {
+        mmu.write32(0x0D000000, bits[i] | (bits[i + 1] << 16));
+    }
+    mmu.write16(0x0D000000, bits.back());
+    for (uint32_t i = 0; i < EEPROM::READ_BITS; i += 2) {
+        uint32_t pair = mmu.read32(0x0D000000);
+        response[i] = pair & 1;
+        response[i + 1] = (pair >> 16) & 1;
+    }
+    check(eepromData(response) == 0xA5A5A5A55A5A5A5Aull, "32-bit EEPROM accesses clock one bit per halfword");
+
+    std::filesystem::path savePath = std::filesystem::temp_directory_path() / "gba_eeprom_test.sav";
+    std::filesystem::remove(savePath);
+    {
+        EEPROM fresh;
+        fresh.mapSaveFile(savePath.string());
+        check(!std::filesystem::exists(savePath), "new EEPROM save waits for the first command");
+        bits = eepromCommand(false, 3, 6, 0x1122334455667788ull);
+        fresh.writeCommand(bits.data(), static_cast<uint32_t>(bits.size()));
+        check(SaveFile::existingSize(savePath.string()) == 0x200, "512-byte EEPROM game gets a 512-byte save");
+    }
+    std::filesystem::remove(savePath);
+
+    {
+        std::ofstream save(savePath, std::ios::binary);
+        std::string image(0x2000, '\xFF');
+        image.replace(0x155 * 8, 8, "\x01\x23\x45\x67\x89\xAB\xCD\xEF");
+        save.write(image.data(), image.size());
+    }
+    {
+        EEPROM existing;
+        existing.mapSaveFile(savePath.string());
+        check(existing.getSize() == EEPROMSize::EEPROM8K, "existing 8KB save selects 8KB EEPROM");
+        for (uint8_t bit : eepromCommand(true, 0x155, 14, 0)) {
+            existing.write(bit);
+        }
+        for (uint8_t& bit : response) {
+            bit = static_cast<uint8_t>(existing.read());
+        }
+        check(eepromData(response) == 0x0123456789ABCDEFull, "bit-serial read of an existing 8KB save uses 14 address bits");
+    }
+    std::filesystem::remove(savePath);
+}
+
+void testSaveFile() {
+    std::cout << "\n=== Save File Tests ===" << std::endl;
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "gba_savefile_test.sav";
+    std::filesystem::remove(path);
+
+    {
+        SaveFile save(0x8000);
+        check(save.map(path.string(), 0x8000), "save file maps");
+        save[0x0010] = 0x5A;
+        save.markDirty(0x0010);
+        save[0x7FFF] = 0xA5;
+        save.markDirty(0x7FFF);
+        save.unmap();
+        check(!save.isMapped() && save[0x0010] == 0x5A, "unmap keeps the data in memory");
+    }
+
+    check(SaveFile::existingSize(path.string()) == 0x8000, "save file has the mapped size");
+
+    {
+        SaveFile save(0x8000, 0x00);
+        check(save.map(path.string(), 0x8000), "save file re-maps");
+        check(save[0x0010] == 0x5A && save[0x7FFF] == 0xA5 && save[0x0011] == 0xFF,
+              "dirty sectors were flushed before unmap");
+    }
+
+    // Another game's save must not leak into a new file through the in-memory copy.
+    std::filesystem::path other = std::filesystem::temp_directory_path() / "gba_savefile_other.sav";
+    std::filesystem::remove(other);
+    {
+        SaveFile save(0x8000);
+        check(save.map(path.string(), 0x8000), "first game's save maps");
+        save.unmap();
+        check(save.map(other.string(), 0x8000), "second game's save maps");
+        check(save[0x0010] == 0xFF && save[0x7FFF] == 0xFF, "a new save file starts erased, not with the previous save");
+        save.reset();
+        check(!save.isMapped() && save.size() == 0x8000 && save[0x0010] == 0xFF, "reset erases the in-memory copy");
+    }
+    check(SaveFile::existingSize(other.string()) == 0x8000, "new save file has the mapped size");
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(other);
+}
+
+bool sameLine(const Compositor::Line& a, const Compositor::Line& b) {
+    return a.top == b.top && a.second == b.second && a.topFlags == b.topFlags && a.secondFlags == b.secondFlags;
+}
+
+void testCompositorKernels() {
+    std::cout << "\n=== Compositor Kernel Tests ===" << std::endl;
+
+    std::mt19937 rng(1234);
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH> colors;
+    alignas(16) std::array<uint16_t, SCREEN_WIDTH> priorities;
+    std::array<uint8_t, SCREEN_WIDTH> window;
+    std::array<uint8_t, SCREEN_WIDTH> semi;
+
+    bool layersMatch = true;
+    bool objectsMatch = true;
+    bool effectsMatch = true;
+    for (int round = 0; round < 200; round++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            colors[x] = static_cast<uint16_t>(rng() & ((rng() & 3) ? 0x7FFF : 0xFFFF));
+            priorities[x] = static_cast<uint16_t>(rng() & 3);
+            window[x] = static_cast<uint8_t>(rng() & 0x3F);
+            semi[x] = static_cast<uint8_t>(rng() & 1);
+        }
+
+        Compositor::Line vector;
+        Compositor::fill(vector, static_cast<uint16_t>(rng() & 0x7FFF), Compositor::TARGET_SECOND);
+        Compositor::Line scalar = vector;
+        uint16_t flags = static_cast<uint16_t>(rng() & 3);
+        Compositor::overlayLayer(vector, colors.data(), window.data(), 1 << (round & 3), flags);
+        Compositor::overlayLayerScalar(scalar, colors.data(), window.data(), 1 << (round & 3), flags, 0, SCREEN_WIDTH);
+        layersMatch &= sameLine(vector, scalar);
+
+        int priority = round & 3;
+        Compositor::overlayObjects(vector, colors.data(), priorities.data(), priority, window.data(), semi.data(), flags);
+        Compositor::overlayObjectsScalar(scalar, colors.data(), priorities.data(), priority, window.data(), semi.data(),
+                                         flags, 0, SCREEN_WIDTH);
+        objectsMatch &= sameLine(vector, scalar);
+
+        Compositor::EffectParams params;
+        params.effect = static_cast<Compositor::Effect>(round % 4);
+        params.eva = static_cast<int>(rng() % 20);
+        params.evb = static_cast<int>(rng() % 20);
+        params.evy = static_cast<int>(rng() % 20);
+        Compositor::applyEffects(vector, window.data(), params);
+        Compositor::applyEffectsScalar(scalar, window.data(), params, 0, SCREEN_WIDTH);
+        effectsMatch &= sameLine(vector, scalar);
+    }
+
+    check(layersMatch, "overlayLayer matches the scalar path");
+    check(objectsMatch, "overlayObjects matches the scalar path");
+    check(effectsMatch, "applyEffects matches the scalar path");
+}
+
+void testBitmapKernels() {
+    std::cout << "\n=== Bitmap Kernel Tests ===" << std::endl;
+
+    std::mt19937 rng(99);
+    std::vector<uint8_t> src(SCREEN_WIDTH * 2);
+    std::vector<uint16_t> palette(257);
+    for (uint8_t& byte : src) byte = static_cast<uint8_t>(rng());
+    for (uint16_t& color : palette) color = static_cast<uint16_t>(rng() & 0x7FFF);
+    src[3] = 0;
+
+    std::vector<BitmapKernels::Kernels> kernels = BitmapKernels::available();
+    std::vector<uint16_t> expected(SCREEN_WIDTH);
+    std::vector<uint16_t> actual(SCREEN_WIDTH);
+    for (const BitmapKernels::Kernels& set : kernels) {
+        kernels.front().directColors(src.data(), expected.data(), SCREEN_WIDTH);
+        set.directColors(src.data(), actual.data(), SCREEN_WIDTH);
+        check(actual == expected, std::string(set.name) + " direct colors match the scalar path");
+
+        kernels.front().paletteIndices(src.data(), palette.data(), expected.data(), SCREEN_WIDTH);
+        set.paletteIndices(src.data(), palette.data(), actual.data(), SCREEN_WIDTH);
+        check(actual == expected, std::string(set.name) + " palette indices match the scalar path");
+    }
+}
+
+std::vector<uint32_t> scaleFrame(const std::vector<uint32_t>& src, ScaleFilter filter, bool vector, int threads,
+                                 int outputWidth = 0, int outputHeight = 0) {
+    Scaler scaler;
+    scaler.setFilter(filter);
+    scaler.setVectorKernels(vector);
+    scaler.setThreads(threads);
+    scaler.setOutputSize(outputWidth, outputHeight);
+    std::vector<uint32_t> dst(scaler.getOutputWidth() * scaler.getOutputHeight());
+    scaler.scale(src.data(), dst.data(), scaler.getOutputWidth() * sizeof(uint32_t));
+    return dst;
+}
+
+void testScaler() {
+    std::cout << "\n=== Scaler Tests ===" << std::endl;
+
+    // Few colors, so the filters find plenty of matching neighbours.
+    std::mt19937 rng(5);
+    const uint32_t colors[] = {0xFF000000, 0xFFFFFFFF, 0xFF3060C0, 0xFFE0A020};
+    std::vector<uint32_t> src(SCREEN_WIDTH * SCREEN_HEIGHT);
+    for (uint32_t& pixel : src) pixel = colors[rng() % 4];
+
+    for (ScaleFilter filter : {ScaleFilter::Scale2x, ScaleFilter::Scale3x, ScaleFilter::Scale4x}) {
+        std::string name = "scale" + std::to_string(Scaler::factor(filter)) + "x";
+        check(scaleFrame(src, filter, true, 0) == scaleFrame(src, filter, false, 0), name + " matches the scalar path");
+        check(scaleFrame(src, filter, true, 3) == scaleFrame(src, filter, true, 0), name + " matches on 4 threads");
+    }
+
+    std::vector<uint32_t> flat(SCREEN_WIDTH * SCREEN_HEIGHT, colors[2]);
+    std::vector<uint32_t> xbr = scaleFrame(flat, ScaleFilter::XBR2x, true, 0);
+    check(std::all_of(xbr.begin(), xbr.end(), [&](uint32_t pixel) { return pixel == colors[2]; }),
+          "xbr2x keeps a flat frame unchanged");
+    check(scaleFrame(src, ScaleFilter::XBR4x, true, 3) == scaleFrame(src, ScaleFilter::XBR4x, true, 0),
+          "xbr4x matches on 4 threads");
+
+    std::vector<uint32_t> uhd = scaleFrame(src, ScaleFilter::XBR4x, true, 3, 3840, 2160);
+    std::vector<uint32_t> xbr4 = scaleFrame(src, ScaleFilter::XBR4x, true, 0);
+    bool letterboxed = uhd[0] == 0xFF000000 && uhd[2159 * 3840 + 299] == 0xFF000000 && uhd[3839] == 0xFF000000;
+    bool fitted = uhd[300] == xbr4[0] && uhd[2159 * 3840 + 3539] == xbr4.back();
+    check(uhd.size() == 3840u * 2160u && letterboxed && fitted, "4K output is the xbr4x frame fitted and letterboxed");
+}
+
+void testSharedExport() {
+    std::cout << "\n=== Shared Export Tests ===" << std::endl;
+
+    std::vector<uint32_t> pixels(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFF102030);
+    std::string name = "gba_test_export_" + std::to_string(std::random_device{}());
+    SharedExport first;
+    SharedExport second;
+    check(first.open(name, 32768), "export creates a new name");
+    check(!second.open(name, 32768), "export refuses a name another writer holds");
+    first.close();
+    check(second.open(name, 32768), "name is free again once its creator closes it");
+    second.close();
+
+#ifndef _WIN32
+    // A writer that exits without closing leaves its region behind.
+    pid_t child = fork();
+    if (child == 0) {
+        SharedExport abandoned;
+        if (abandoned.open(name, 32768)) {
+            abandoned.publishFrame(pixels.data(), SCREEN_WIDTH * sizeof(uint32_t), PixelFormat::ARGB8888);
+        }
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+
+    SharedExport successor;
+    check(successor.open(name, 32768), "export takes over a region whose writer has exited");
+    successor.publishFrame(pixels.data(), SCREEN_WIDTH * sizeof(uint32_t), PixelFormat::ARGB8888);
+
+    std::string path = "/" + name;
+    int file = shm_open(path.c_str(), O_RDONLY, 0);
+    void* address = file >= 0 ? mmap(nullptr, sizeof(SharedExport::Region), PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+    if (address != MAP_FAILED) {
+        const SharedExport::Region* region = static_cast<const SharedExport::Region*>(address);
+        check(region->header.epoch == 2, "takeover bumps the epoch");
+        check(region->header.framesPublished.load() == 2, "takeover continues the frame counter");
+        check(region->frames[0].sequence.load() == 4 && region->frames[1].sequence.load() == 4,
+              "takeover moves slot sequences past the old writer's");
+        munmap(address, sizeof(SharedExport::Region));
+    } else {
+        check(false, "taken-over region can be mapped");
+    }
+    if (file >= 0) close(file);
+
+    successor.close();
+    file = shm_open(path.c_str(), O_RDONLY, 0);
+    check(file >= 0, "closing a taken-over region leaves its name in place");
+    if (file >= 0) close(file);
+
+    // Several processes racing for the same abandoned region: exactly one may claim it.
+    bool oneClaim = true;
+    for (int round = 0; round < 8; round++) {
+        shm_unlink(path.c_str());
+        child = fork();
+        if (child == 0) {
+            SharedExport abandoned;
+            _exit(abandoned.open(name, 32768) ? 0 : 1);
+        }
+        waitpid(child, nullptr, 0);
+
+        // Closing start releases every contender at once; each reports on tried and
+        // then stays alive until hold closes, so a loser cannot inherit the region.
+        int start[2];
+        int tried[2];
+        int hold[2];
+        if (pipe(start) != 0 || pipe(tried) != 0 || pipe(hold) != 0) break;
+        std::vector<pid_t> contenders;
+        for (int i = 0; i < 4; i++) {
+            pid_t contender = fork();
+            if (contender == 0) {
+                close(start[1]);
+                close(tried[0]);
+                close(hold[1]);
+                char byte = 0;
+                while (read(start[0], &byte, 1) > 0) {}
+                SharedExport claim;
+                bool claimed = claim.open(name, 32768);
+                if (write(tried[1], &byte, 1) != 1) _exit(2);
+                while (read(hold[0], &byte, 1) > 0) {}
+                _exit(claimed ? 0 : 1);
+            }
+            contenders.push_back(contender);
+        }
+        close(start[0]);
+        close(tried[1]);
+        close(hold[0]);
+        close(start[1]);
+        char reports[4];
+        size_t received = 0;
+        while (received < sizeof(reports)) {
+            ssize_t count = read(tried[0], reports + received, sizeof(reports) - received);
+            if (count <= 0) break;
+            received += static_cast<size_t>(count);
+        }
+        close(tried[0]);
+        close(hold[1]);
+
+        int claims = 0;
+        for (pid_t contender : contenders) {
+            int status = 0;
+            waitpid(contender, &status, 0);
+            claims += WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        oneClaim &= claims == 1;
+    }
+    check(oneClaim, "racing successors claim an abandoned region exactly once");
+    shm_unlink(path.c_str());
+#endif
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+uint32_t le32(const std::vector<uint8_t>& bytes, size_t offset) {
+    return bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (static_cast<uint32_t>(bytes[offset + 3]) << 24);
+}
+
+void testCaptureSplit() {
+    std::cout << "\n=== Capture Split Tests ===" << std::endl;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "gba_capture_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::filesystem::path first = directory / "out.wav";
+    std::filesystem::path second = directory / "out.001.wav";
+
+    // Ten blocks fit in the audio queue, so nothing is dropped on the way in.
+    std::vector<int16_t> samples(10 * 1000);
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = static_cast<int16_t>(i * 7);
+    {
+        Capture capture;
+        // Rounded down to whole stereo frames.
+        capture.setAudioSplitBytes(12002);
+        check(capture.start("", Capture::VideoFormat::Y4M, first.string()), "audio capture starts");
+        for (size_t i = 0; i < samples.size(); i += 1000) capture.pushAudio(samples.data() + i, 1000);
+        capture.stop();
+        check(capture.getDroppedSamples() == 0, "audio within the queue is not dropped");
+    }
+
+    std::vector<uint8_t> a = readFile(first);
+    std::vector<uint8_t> b = readFile(second);
+    bool headers = a.size() == 44 + 12000 && b.size() == 44 + 8000 &&
+                   std::memcmp(a.data(), "RIFF", 4) == 0 && std::memcmp(b.data(), "RIFF", 4) == 0 &&
+                   le32(a, 4) == 36 + 12000 && le32(a, 40) == 12000 && le32(b, 4) == 36 + 8000 && le32(b, 40) == 8000;
+    check(headers, "WAV output splits at the threshold and both files have matching RIFF headers");
+    check(!std::filesystem::exists(directory / "out.002.wav"), "no extra part is started");
+
+    bool samePCM = headers;
+    if (headers) {
+        std::vector<uint8_t> pcm(a.begin() + 44, a.end());
+        pcm.insert(pcm.end(), b.begin() + 44, b.end());
+        samePCM = std::memcmp(pcm.data(), samples.data(), pcm.size()) == 0;
+    }
+    check(samePCM, "split parts hold every sample in order");
+
+    // With the next part's name taken by a directory, audio past the threshold is dropped and counted.
+    std::filesystem::remove(second);
+    std::filesystem::create_directory(second);
+    {
+        Capture capture;
+        capture.setAudioSplitBytes(12000);
+        capture.start("", Capture::VideoFormat::Y4M, first.string());
+        for (size_t i = 0; i < samples.size(); i += 1000) capture.pushAudio(samples.data() + i, 1000);
+        capture.stop();
+        check(capture.getDroppedSamples() == 2000 && readFile(first).size() == 44 + 12000,
+              "audio that cannot go to a new part is dropped and counted in stereo frames");
+    }
+
+    // Pushing far more than the queue holds: every stereo frame is either written or counted.
+    std::filesystem::remove(second);
+    std::vector<int16_t> burst(4096, 1);
+    {
+        Capture capture;
+        capture.start("", Capture::VideoFormat::Y4M, first.string());
+        for (int i = 0; i < 512; i++) capture.pushAudio(burst.data(), burst.size());
+        capture.stop();
+        uint64_t written = (readFile(first).size() - 44) / 4;
+        check(written + capture.getDroppedSamples() == 512 * 2048ull, "queue overflow accounts for every sample");
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+void testHeadlessAudio() {
+    std::cout << "\n=== Headless Audio Tests ===" << std::endl;
+
+    // An embedder that only calls runFrame must get each frame's samples, not a stalled or growing buffer.
+    GBA gba;
+    size_t smallest = ~size_t(0);
+    size_t largest = 0;
+    for (int frame = 0; frame < 30; frame++) {
+        gba.runFrame();
+        smallest = std::min(smallest, gba.getAudioSamples().size());
+        largest = std::max(largest, gba.getAudioSamples().size());
+    }
+    check(smallest >= 1096 && largest <= 1100, "runFrame yields one frame of samples without clearAudioSamples");
+}
+
+void setupScene(MMU& mmu, std::mt19937& rng, uint16_t mode) {
+    for (uint32_t a = 0; a < 0x18000; a += 2) mmu.write16(0x06000000 + a, static_cast<uint16_t>(rng()));
+    for (uint32_t a = 0; a < 0x400; a += 2) mmu.write16(0x05000000 + a, static_cast<uint16_t>(rng() & 0x7FFF));
+    for (uint32_t a = 0; a < 0x400; a += 2) mmu.write16(0x07000000 + a, static_cast<uint16_t>(rng()));
+    mmu.write16(0x04000000, mode | 0x7F00 | static_cast<uint16_t>(rng() & 0x0050));
+    for (uint32_t a = 0x08; a < 0x56; a += 2) mmu.write16(0x04000000 + a, static_cast<uint16_t>(rng()));
+}
+
+void stepFrame(MMU& mmu, PPU& ppu, std::mt19937& rng, bool rasterChanges) {
+    for (int line = 0; line < 228; line++) {
+        if (rasterChanges && line == 80) mmu.write16(0x04000010, static_cast<uint16_t>(rng()));
+        // Streams VRAM a little on every line, as HBlank DMA would.
+        if (rasterChanges) mmu.write32(0x06000000 + (rng() % 0x18000 & ~3u), static_cast<uint32_t>(rng()));
+        ppu.step(1232);
+    }
+}
+
+uint64_t hashFrame(const uint32_t* pixels) {
+    uint64_t hash = 1469598103934665603ull;
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        hash = (hash ^ pixels[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t renderScene(uint16_t mode, int threads) {
+    std::mt19937 rng(100 + mode);
+    MMU mmu;
+    PPU ppu(mmu);
+    mmu.connectPPU(&ppu);
+    ppu.setRenderThreads(threads);
+    ppu.reset();
+    setupScene(mmu, rng, mode);
+    for (int frame = 0; frame < 6; frame++) {
+        stepFrame(mmu, ppu, rng, true);
+    }
+    return hashFrame(ppu.getFramebuffer());
+}
+
+void testRenderThreads() {
+    std::cout << "\n=== Render Thread Tests ===" << std::endl;
+
+    for (uint16_t mode = 0; mode <= 5; mode++) {
+        uint64_t reference = renderScene(mode, 0);
+        bool same = true;
+        for (int threads : {1, 2, 4}) {
+            same &= renderScene(mode, threads) == reference;
+        }
+        check(same, "mode " + std::to_string(mode) + " renders the same on 1/2/4 threads");
+    }
+}
+
+void testColorCorrection() {
+    std::cout << "\n=== Color Correction Tests ===" << std::endl;
+
+    bool identity = true;
+    for (uint32_t color = 0; color < 0x8000; color++) {
+        uint32_t r = color & 0x1F;
+        uint32_t g = (color >> 5) & 0x1F;
+        uint32_t b = (color >> 10) & 0x1F;
+        identity &= ColorCorrection::toARGB(static_cast<uint16_t>(color), ColorProfile::None) ==
+                    (0xFF000000 | (r << 19) | (g << 11) | (b << 3));
+        identity &= ColorCorrection::toRGB565(static_cast<uint16_t>(color), ColorProfile::None) ==
+                    ((r << 11) | (g << 6) | ((g >> 4) << 5) | b);
+    }
+    check(identity, "None passes every color through unchanged");
+
+    bool black = true;
+    for (ColorProfile profile : {ColorProfile::None, ColorProfile::GBA, ColorProfile::GBASP}) {
+        black &= ColorCorrection::toARGB(0, profile) == 0xFF000000 && ColorCorrection::toRGB565(0, profile) == 0;
+    }
+    check(black, "black stays black in every profile");
+
+    // The GBA panel's primaries add up past full scale in red and fall short at its 255/280
+    // luminance, so its white is slightly tinted; the SP's mix rows each sum to one.
+    check(ColorCorrection::toARGB(0x7FFF, ColorProfile::GBA) == 0xFFFCEEF2, "GBA white maps to the panel's white point");
+    check(ColorCorrection::toARGB(0x7FFF, ColorProfile::GBASP) == 0xFFFFFFFF &&
+          ColorCorrection::toRGB565(0x7FFF, ColorProfile::GBASP) == 0xFFFF, "GBA SP white stays full white");
+
+    MMU mmu;
+    PPU ppu(mmu);
+    mmu.connectPPU(&ppu);
+    ppu.reset();
+    mmu.write16(0x05000000, 0x7FFF);
+    mmu.write16(0x04000000, 0x0000);
+    std::mt19937 rng(50);
+    ppu.setColorProfile(ColorProfile::GBA);
+    stepFrame(mmu, ppu, rng, false);
+    stepFrame(mmu, ppu, rng, false);
+    check(ppu.getFramebuffer()[80 * SCREEN_WIDTH + 120] == 0xFFFCEEF2, "PPU output uses the selected profile");
+}
+
+bool pixelIs(const PPU& ppu, int x, int y, uint16_t color) {
+    return ppu.getFramebuffer()[y * SCREEN_WIDTH + x] == ColorCorrection::toARGB(color, ColorProfile::None);
+}
+
+void testWindows() {
+    std::cout << "\n=== Window Tests ===" << std::endl;
+
+    std::mt19937 rng(3);
+    MMU mmu;
+    PPU ppu(mmu);
+    mmu.connectPPU(&ppu);
+    ppu.reset();
+
+    // BG0 (priority 0) is solid red and BG1 (priority 1) solid green over a blue backdrop.
+    for (uint32_t a = 0; a < 0x20; a += 2) mmu.write16(0x06000000 + a, 0x1111);
+    for (uint32_t a = 0; a < 0x800; a += 2) {
+        mmu.write16(0x06004000 + a, 0x0000);
+        mmu.write16(0x06004800 + a, 0x1000);
+    }
+    mmu.write16(0x05000000, 0x7C00);
+    mmu.write16(0x05000002, 0x001F);
+    mmu.write16(0x05000022, 0x03E0);
+    mmu.write16(0x04000008, 0x0800);
+    mmu.write16(0x0400000A, 0x0901);
+
+    mmu.write16(0x04000040, (20 << 8) | 100);
+    mmu.write16(0x04000044, (20 << 8) | 60);
+    mmu.write16(0x04000042, (200 << 8) | 30);
+    mmu.write16(0x04000046, (40 << 8) | 120);
+    mmu.write16(0x04000048, 0x0302);
+    mmu.write16(0x0400004A, 0x0000);
+    mmu.write16(0x04000000, 0x6300);
+    stepFrame(mmu, ppu, rng, false);
+
+    check(pixelIs(ppu, 50, 30, 0x03E0) && pixelIs(ppu, 99, 59, 0x03E0), "WIN0 shows only the layers WININ enables");
+    check(pixelIs(ppu, 100, 30, 0x7C00) && pixelIs(ppu, 50, 60, 0x7C00) && pixelIs(ppu, 150, 80, 0x7C00),
+          "outside every window shows the WINOUT layers");
+    check(pixelIs(ppu, 25, 50, 0x03E0) && pixelIs(ppu, 25, 70, 0x001F), "WIN0 takes priority over WIN1 where they overlap");
+    check(pixelIs(ppu, 210, 50, 0x001F) && pixelIs(ppu, 239, 119, 0x001F) && pixelIs(ppu, 5, 100, 0x001F) &&
+          pixelIs(ppu, 30, 100, 0x7C00) && pixelIs(ppu, 199, 100, 0x7C00),
+          "WIN1 with X2 < X1 wraps around the screen edge");
+    check(pixelIs(ppu, 210, 39, 0x7C00) && pixelIs(ppu, 210, 120, 0x7C00), "windows end at their vertical bounds");
+
+    mmu.write16(0x0400004A, 0x0001);
+    stepFrame(mmu, ppu, rng, false);
+    check(pixelIs(ppu, 150, 80, 0x001F) && pixelIs(ppu, 50, 30, 0x03E0), "WINOUT change reveals BG0 outside the windows");
+}
+
+void testMosaic() {
+    std::cout << "\n=== Mosaic Tests ===" << std::endl;
+
+    auto bitmapColor = [](int x, int y) { return static_cast<uint16_t>((x * 37 + y * 1021) & 0x7FFF); };
+    auto objColor = [](int index) { return static_cast<uint16_t>((index << 5) | (64 - index)); };
+
+    for (int threads : {0, 4}) {
+        MMU mmu;
+        PPU ppu(mmu);
+        mmu.connectPPU(&ppu);
+        ppu.setRenderThreads(threads);
+        ppu.reset();
+
+        // Mode 3 BG2 with 4x4 blocks, switching to 3x3 at line 96, a multiple of both sizes.
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                mmu.write16(0x06000000 + (y * SCREEN_WIDTH + x) * 2, bitmapColor(x, y));
+            }
+        }
+        mmu.write16(0x0400000C, 0x0040);
+        mmu.write16(0x04000000, 0x0403);
+        for (int frame = 0; frame < 2; frame++) {
+            for (int line = 0; line < 228; line++) {
+                if (line == 0) mmu.write16(0x0400004C, 0x0033);
+                if (line == 96) mmu.write16(0x0400004C, 0x0022);
+                ppu.step(1232);
+            }
+        }
+
+        bool blocks = true;
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            int size = y < 96 ? 4 : 3;
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                blocks &= pixelIs(ppu, x, y, bitmapColor(x - x % size, y - y % size));
+            }
+        }
+        check(blocks, "BG mosaic replicates blocks across a mid-frame size change (" + std::to_string(threads) + " threads)");
+
+        // An 8x8 256-color sprite at (41, 21) with 3x2 OBJ mosaic; blocks start on the screen grid
+        // but never sample left of or above the sprite.
+        for (int i = 0; i < 64; i += 2) mmu.write16(0x06010000 + i, static_cast<uint16_t>((i + 1) | ((i + 2) << 8)));
+        for (int i = 1; i <= 64; i++) mmu.write16(0x05000200 + i * 2, objColor(i));
+        for (uint32_t a = 0; a < 0x400; a += 8) mmu.write16(0x07000000 + a, 0x0200);
+        mmu.write16(0x07000000, 21 | 0x1000 | 0x2000);
+        mmu.write16(0x07000002, 41);
+        mmu.write16(0x07000004, 0);
+        mmu.write16(0x05000000, 0x7C00);
+        mmu.write16(0x0400004C, 0x1200);
+        mmu.write16(0x04000000, 0x1040);
+        std::mt19937 rng(5);
+        stepFrame(mmu, ppu, rng, false);
+        stepFrame(mmu, ppu, rng, false);
+
+        bool sprite = true;
+        for (int y = 16; y < 34; y++) {
+            for (int x = 36; x < 54; x++) {
+                uint16_t expected = 0x7C00;
+                if (x >= 41 && x < 49 && y >= 21 && y < 29) {
+                    int row = std::max(y - y % 2, 21) - 21;
+                    int column = std::max(x - x % 3, 41) - 41;
+                    expected = objColor(row * 8 + column + 1);
+                }
+                sprite &= pixelIs(ppu, x, y, expected);
+            }
+        }
+        check(sprite, "OBJ mosaic replicates sprite blocks (" + std::to_string(threads) + " threads)");
+    }
+}
+
+void testAffineTexels() {
+    std::cout << "\n=== Affine Texel Tests ===" << std::endl;
+
+    std::mt19937 rng(35);
+    bool same = true;
+    for (int round = 0; round < 2000; round++) {
+        int32_t x = static_cast<int32_t>(rng() % 0x200000) - 0x100000;
+        int32_t y = static_cast<int32_t>(rng() % 0x200000) - 0x100000;
+        int32_t pa = static_cast<int16_t>(rng());
+        int32_t pc = static_cast<int16_t>(rng());
+        if (round % 4 == 0) {
+            x = static_cast<int32_t>(rng() % 0x10000);
+            pa = static_cast<int32_t>(rng() % 0x200);
+            pc = static_cast<int32_t>(rng() % 0x100) - 0x80;
+        }
+        int sizeShift = round % 4;
+        bool wrap = (round / 4) % 2;
+
+        std::array<int32_t, SCREEN_WIDTH> map;
+        std::array<int32_t, SCREEN_WIDTH> pixel;
+        std::array<int32_t, SCREEN_WIDTH> scalarMap;
+        std::array<int32_t, SCREEN_WIDTH> scalarPixel;
+        affineTexels(x, y, pa, pc, sizeShift, wrap, map.data(), pixel.data());
+        affineTexelsScalar(x, y, pa, pc, sizeShift, wrap, scalarMap.data(), scalarPixel.data(), 0, SCREEN_WIDTH);
+        for (int i = 0; i < SCREEN_WIDTH; i++) {
+            same &= map[i] == scalarMap[i] && (map[i] < 0 || pixel[i] == scalarPixel[i]);
+        }
+    }
+    check(same, "affineTexels matches the scalar path for random matrices, sizes and wraparound");
+}
+
+uint16_t affineColor(int index) {
+    return static_cast<uint16_t>(index * 63 + 7);
+}
+
+void testAffineBackground() {
+    std::cout << "\n=== Affine Background Tests ===" << std::endl;
+
+    // 128x128 BG2 whose 256 tiles each hold a distinct pattern, so every texel is identifiable.
+    auto texel = [](int tx, int ty) { return ((ty >> 3) * 16 + (tx >> 3) + (ty & 7) * 8 + (tx & 7)) % 255 + 1; };
+    const int32_t refX = -5000;
+    const int32_t refY = 3000;
+    const int32_t pa = 0xC0;
+    const int32_t pb = 0x50;
+    const int32_t pc = -0x30;
+    const int32_t pd = 0xE0;
+
+    for (bool wrap : {false, true}) {
+        for (int threads : {0, 4}) {
+            MMU mmu;
+            PPU ppu(mmu);
+            mmu.connectPPU(&ppu);
+            ppu.setRenderThreads(threads);
+            ppu.reset();
+
+            for (int tile = 0; tile < 256; tile++) {
+                for (int p = 0; p < 64; p += 2) {
+                    int tx = (tile % 16) * 8 + p % 8;
+                    int ty = (tile / 16) * 8 + p / 8;
+                    mmu.write16(0x06000000 + tile * 64 + p, static_cast<uint16_t>(texel(tx, ty) | (texel(tx + 1, ty) << 8)));
+                }
+            }
+            for (int i = 0; i < 256; i += 2) mmu.write16(0x06004000 + i, static_cast<uint16_t>(i | ((i + 1) << 8)));
+            for (int i = 1; i < 256; i++) mmu.write16(0x05000000 + i * 2, affineColor(i));
+            mmu.write16(0x05000000, 0x7C00);
+
+            mmu.write16(0x04000020, static_cast<uint16_t>(pa));
+            mmu.write16(0x04000022, static_cast<uint16_t>(pb));
+            mmu.write16(0x04000024, static_cast<uint16_t>(pc));
+            mmu.write16(0x04000026, static_cast<uint16_t>(pd));
+            mmu.write32(0x04000028, static_cast<uint32_t>(refX) & 0x0FFFFFFF);
+            mmu.write32(0x0400002C, static_cast<uint32_t>(refY) & 0x0FFFFFFF);
+            mmu.write16(0x0400000C, 0x0800 | (wrap ? 0x2000 : 0));
+            mmu.write16(0x04000000, 0x0402);
+            std::mt19937 rng(1);
+            stepFrame(mmu, ppu, rng, false);
+            stepFrame(mmu, ppu, rng, false);
+
+            bool matches = true;
+            for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                for (int x = 0; x < SCREEN_WIDTH; x++) {
+                    int tx = (refX + pa * x + pb * y) >> 8;
+                    int ty = (refY + pc * x + pd * y) >> 8;
+                    uint16_t expected = 0x7C00;
+                    if (wrap) {
+                        expected = affineColor(texel(tx & 127, ty & 127));
+                    } else if (tx >= 0 && tx < 128 && ty >= 0 && ty < 128) {
+                        expected = affineColor(texel(tx, ty));
+                    }
+                    matches &= pixelIs(ppu, x, y, expected);
+                }
+            }
+            check(matches, std::string("rotated and scaled BG2 with wraparound ") + (wrap ? "on" : "off") + " (" +
+                           std::to_string(threads) + " threads)");
+        }
+    }
+}
+
+void testAffineSprites() {
+    std::cout << "\n=== Affine Sprite Tests ===" << std::endl;
+
+    struct Sprite {
+        int x;
+        int y;
+        bool doubleSize;
+        int16_t pa, pb, pc, pd;
+    };
+    // A 2x zoom clipped to its 16x16 box, the same zoom in a double-size box, and a
+    // 90-degree rotation whose double-size box crosses the left and bottom screen edges.
+    const Sprite sprites[3] = {
+        {60, 40, false, 0x80, 0, 0, 0x80},
+        {100, 40, true, 0x80, 0, 0, 0x80},
+        {-12, 140, true, 0, 0x100, -0x100, 0},
+    };
+    auto texel = [](int tx, int ty) { return (ty * 16 + tx) % 255 + 1; };
+
+    for (int threads : {0, 4}) {
+        MMU mmu;
+        PPU ppu(mmu);
+        mmu.connectPPU(&ppu);
+        ppu.setRenderThreads(threads);
+        ppu.reset();
+
+        // 16x16 256-color sprite at tile 0 with 1D mapping: each 8x8 tile is 64 bytes, rows of two tiles.
+        for (int ty = 0; ty < 16; ty++) {
+            for (int tx = 0; tx < 16; tx += 2) {
+                uint32_t offset = ((ty / 8) * 2 + tx / 8) * 64 + (ty % 8) * 8 + tx % 8;
+                mmu.write16(0x06010000 + offset, static_cast<uint16_t>(texel(tx, ty) | (texel(tx + 1, ty) << 8)));
+            }
+        }
+        for (int i = 1; i < 256; i++) mmu.write16(0x05000200 + i * 2, affineColor(i));
+        mmu.write16(0x05000000, 0x7C00);
+
+        for (uint32_t a = 0; a < 0x400; a += 8) mmu.write16(0x07000000 + a, 0x0200);
+        for (int i = 0; i < 3; i++) {
+            const Sprite& sprite = sprites[i];
+            uint32_t entry = 0x07000000 + i * 8;
+            mmu.write16(entry, static_cast<uint16_t>(sprite.y | 0x0100 | (sprite.doubleSize ? 0x0200 : 0) | 0x2000));
+            mmu.write16(entry + 2, static_cast<uint16_t>((sprite.x & 0x1FF) | (i << 9) | 0x4000));
+            mmu.write16(entry + 4, 0);
+            uint32_t group = 0x07000000 + i * 0x20;
+            mmu.write16(group + 0x06, static_cast<uint16_t>(sprite.pa));
+            mmu.write16(group + 0x0E, static_cast<uint16_t>(sprite.pb));
+            mmu.write16(group + 0x16, static_cast<uint16_t>(sprite.pc));
+            mmu.write16(group + 0x1E, static_cast<uint16_t>(sprite.pd));
+        }
+        mmu.write16(0x04000000, 0x1040);
+        std::mt19937 rng(1);
+        stepFrame(mmu, ppu, rng, false);
+        stepFrame(mmu, ppu, rng, false);
+
+        std::vector<uint16_t> expected(SCREEN_WIDTH * SCREEN_HEIGHT, 0x7C00);
+        for (const Sprite& sprite : sprites) {
+            int bounds = sprite.doubleSize ? 32 : 16;
+            for (int iy = 0; iy < bounds; iy++) {
+                for (int ix = 0; ix < bounds; ix++) {
+                    int x = sprite.x + ix;
+                    int y = sprite.y + iy;
+                    if (x < 0 || x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) continue;
+                    int tx = (sprite.pa * (ix - bounds / 2) + sprite.pb * (iy - bounds / 2) + (16 << 7)) >> 8;
+                    int ty = (sprite.pc * (ix - bounds / 2) + sprite.pd * (iy - bounds / 2) + (16 << 7)) >> 8;
+                    if (tx < 0 || tx >= 16 || ty < 0 || ty >= 16) continue;
+                    expected[y * SCREEN_WIDTH + x] = affineColor(texel(tx, ty));
+                }
+            }
+        }
+
+        bool matches = true;
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                matches &= pixelIs(ppu, x, y, expected[y * SCREEN_WIDTH + x]);
+            }
+        }
+        check(matches, "scaled, rotated and double-size sprites clip to their boxes and the screen (" +
+                       std::to_string(threads) + " threads)");
+        check(pixelIs(ppu, 60, 40, affineColor(texel(4, 4))) && pixelIs(ppu, 100, 40, affineColor(texel(0, 0))),
+              "double size shows the whole zoomed sprite where a normal box shows its centre");
+    }
+}
+
+void testLineSkipping() {
+    std::cout << "\n=== Line Skipping Tests ===" << std::endl;
+
+    std::mt19937 rng(7);
+    MMU mmu;
+    PPU ppu(mmu);
+    mmu.connectPPU(&ppu);
+    ppu.setLineSkipping(true);
+    ppu.reset();
+
+    for (uint32_t a = 0; a < 0x14000; a += 2) mmu.write16(0x06000000 + a, static_cast<uint16_t>(rng() & 0x7FFF));
+    for (uint32_t a = 0; a < 0x400; a += 2) mmu.write16(0x07000000 + a, 0x0200);
+    mmu.write16(0x07000000, 40);
+    mmu.write16(0x07000002, 0);
+    mmu.write16(0x07000004, 512);
+    mmu.write16(0x04000000, 0x0403);
+
+    auto missesPerFrame = [&]() {
+        LineSkipStats before = ppu.getLineSkipStats();
+        stepFrame(mmu, ppu, rng, false);
+        LineSkipStats after = ppu.getLineSkipStats();
+        return after.misses - before.misses;
+    };
+
+    missesPerFrame();
+    missesPerFrame();
+    LineSkipStats before = ppu.getLineSkipStats();
+    uint64_t misses = missesPerFrame();
+    LineSkipStats after = ppu.getLineSkipStats();
+    check(misses == 0 && after.hits - before.hits == SCREEN_HEIGHT, "static scene reuses every line");
+
+    // VRAM changes are tracked per 2 KiB block, so every line sharing the block misses.
+    constexpr uint32_t VRAM_BLOCK_SIZE = 0x800;
+    uint32_t offset = (70 * SCREEN_WIDTH + 12) * 2;
+    uint32_t blockStart = offset / VRAM_BLOCK_SIZE * VRAM_BLOCK_SIZE;
+    uint64_t blockLines = (blockStart + VRAM_BLOCK_SIZE - 1) / (SCREEN_WIDTH * 2) - blockStart / (SCREEN_WIDTH * 2) + 1;
+    mmu.write8(0x06000000 + offset, 0x34);
+    check(missesPerFrame() == blockLines, "one VRAM byte change misses only the lines of its block");
+
+    mmu.write16(0x05000200 + 2, 0x7FFF);
+    check(missesPerFrame() == 0, "OBJ palette change with OBJ disabled misses nothing");
+
+    mmu.write16(0x04000000, 0x1403);
+    missesPerFrame();
+    missesPerFrame();
+    mmu.write16(0x07000000, 100);
+    check(missesPerFrame() == 16, "moving an 8x8 sprite misses its old and new lines");
+
+    mmu.write16(0x05000000, 0x001F);
+    check(missesPerFrame() == SCREEN_HEIGHT, "backdrop change misses every line");
+}
+
+bool sameRanges(const std::vector<LineRange>& ranges, std::vector<LineRange> expected) {
+    return std::equal(ranges.begin(), ranges.end(), expected.begin(), expected.end(),
+                      [](const LineRange& a, const LineRange& b) { return a.first == b.first && a.count == b.count; });
+}
+
+void testDirtyLines() {
+    std::cout << "\n=== Dirty Line Tests ===" << std::endl;
+
+    for (int threads : {0, 4}) {
+        std::mt19937 rng(48);
+        MMU mmu;
+        PPU ppu(mmu);
+        mmu.connectPPU(&ppu);
+        ppu.setRenderThreads(threads);
+        ppu.reset();
+        for (uint32_t a = 0; a < 0x12C00; a += 2) mmu.write16(0x06000000 + a, static_cast<uint16_t>(rng() & 0x7FFF));
+        mmu.write16(0x04000000, 0x0403);
+        stepFrame(mmu, ppu, rng, false);
+        stepFrame(mmu, ppu, rng, false);
+        std::string suffix = " (" + std::to_string(threads) + " threads)";
+        check(ppu.getDirtyLines().empty(), "static frame reports no dirty lines" + suffix);
+
+        mmu.write16(0x06000000 + (70 * SCREEN_WIDTH + 12) * 2, 0x7FFF ^ mmu.read16(0x06000000 + (70 * SCREEN_WIDTH + 12) * 2));
+        stepFrame(mmu, ppu, rng, false);
+        check(sameRanges(ppu.getDirtyLines(), {{70, 1}}), "one changed line reports exactly that line" + suffix);
+
+        for (int line : {20, 21, 90}) {
+            uint32_t address = 0x06000000 + (line * SCREEN_WIDTH + 100) * 2;
+            mmu.write16(address, 0x7FFF ^ mmu.read16(address));
+        }
+        stepFrame(mmu, ppu, rng, false);
+        check(sameRanges(ppu.getDirtyLines(), {{20, 2}, {90, 1}}), "adjacent changed lines merge into one range" + suffix);
+    }
+
+    PresentDamage damage;
+    check(damage.next({}, true).all(), "nothing presented yet means every line is still owed");
+    PresentDamage::Lines lines = damage.next({{10, 2}}, false);
+    check(lines.count() == 2 && lines[10] && lines[11], "consumed frame uploads only its own lines");
+    lines = damage.next({{50, 1}}, true);
+    check(lines.count() == 3 && lines[10] && lines[11] && lines[50], "skipped frame's lines carry into the next one");
+    lines = damage.next({{60, 1}}, true);
+    check(lines.count() == 4 && lines[60], "lines keep carrying while frames go unconsumed");
+    lines = damage.next({{60, 1}}, false);
+    check(lines.count() == 1 && lines[60], "carried lines are dropped once a frame is consumed");
+}
+
 void testROMExecution(const std::string& romPath) {
     std::cout << "\n=== ROM Execution Test: " << romPath << " ===" << std::endl;
     
@@ -183,6 +1318,28 @@ int main(int argc, char* argv[]) {
     std::cout << "==============================" << std::endl;
     
     testCPUBasics();
+    testIOByteWrites();
+    testDirtyMarking();
+#ifdef GBA_WATCHPOINTS
+    testWatchpoints();
+#endif
+    testEEPROM();
+    testSaveFile();
+    testCompositorKernels();
+    testBitmapKernels();
+    testScaler();
+    testSharedExport();
+    testHeadlessAudio();
+    testCaptureSplit();
+    testRenderThreads();
+    testColorCorrection();
+    testWindows();
+    testMosaic();
+    testAffineTexels();
+    testAffineBackground();
+    testAffineSprites();
+    testLineSkipping();
+    testDirtyLines();
     
     if (argc > 1) {
         testROMExecution(argv[1]);
@@ -195,5 +1352,5 @@ int main(int argc, char* argv[]) {
     std::cout << "Tests Complete" << std::endl;
     std::cout << "==============================" << std::endl;
     
-    return 0;
+    return failures ? 1 : 0;
 }